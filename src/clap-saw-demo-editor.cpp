@@ -95,8 +95,8 @@ bool ClapSawDemo::guiCreate(const char *api, bool isFloating) noexcept
 #if IS_LINUX
     addLinuxVSTGUIPlugin(this);
 #endif
-    editor =
-        new ClapSawDemoEditor(toUiQ, fromUiQ, dataCopyForUI, [this]() { editorParamsFlush(); });
+    editor = new ClapSawDemoEditor(paramMirror, toUi, fromUi, dataCopyForUI,
+                                   [this]() { editorParamsFlush(); });
 
     return editor != nullptr;
 }
@@ -152,23 +152,10 @@ bool ClapSawDemo::guiSetParent(const clap_window *window) noexcept
     // Once we are reparented, we can set up our UI
     editor->setupUI();
 
-    if (dataCopyForUI.isProcessing)
-    {
-        // and ask the engine to refresh from the processing thread
-        refreshUIValues = true;
-    }
-    else
-    {
-        // Pull the parameters on the main thread
-        for (const auto &[k, v] : paramToValue)
-        {
-            auto r = ToUI();
-            r.type = ToUI::PARAM_VALUE;
-            r.id = k;
-            r.value = *v;
-            toUiQ.try_enqueue(r);
-        }
-    }
+    // The mirror always holds the engine's values, so the editor's first idle can show every
+    // one of them; we just have to flag them all
+    paramMirror.markAll();
+
     // And we are done!
     return true;
 }
@@ -249,10 +236,11 @@ struct ClapSawDemoBackground : public VSTGUI::CView
     double uiScale{1.0};
 };
 
-ClapSawDemoEditor::ClapSawDemoEditor(ClapSawDemo::SynthToUI_Queue_t &i,
-                                     ClapSawDemo::UIToSynth_Queue_t &o,
+ClapSawDemoEditor::ClapSawDemoEditor(ClapSawDemo::ParamMirror_t &m,
+                                     ClapSawDemo::SynthToUI_Ring_t &i,
+                                     ClapSawDemo::UIToSynth_Channel_t &o,
                                      const ClapSawDemo::DataCopyForUI &d, std::function<void()> pf)
-    : inbound(i), outbound(o), synthData(d), paramRequestFlush(std::move(pf))
+    : paramMirror(m), inbound(i), outbound(o), synthData(d), paramRequestFlush(std::move(pf))
 {
     frame = new VSTGUI::CFrame(
         VSTGUI::CRect(0, 0, ClapSawDemo::GUI_DEFAULT_W, ClapSawDemo::GUI_DEFAULT_H), this);
@@ -367,7 +355,6 @@ void ClapSawDemoEditor::setupUI()
     paramIdToCControl[ClapSawDemo::pmUnisonSpread] = oscSpread;
 
     oscDetune = mkSliderWithLabel(130, oscRow, tags::oscdetune, "Detune");
-    oscDetune->setMin(-1);
     oscDetune->setDrawStyle(oscDetune->getDrawStyle() | VSTGUI::CSlider::kDrawValueFromCenter |
                             VSTGUI::CSlider::kDrawInverted);
     paramIdToCControl[ClapSawDemo::pmOscDetune] = oscDetune;
@@ -479,118 +466,63 @@ uint32_t ClapSawDemoEditor::paramIdFromTag(int32_t tag)
 /*
  * The primary thing valueChanged needs to do is
  *
- * 1; Scale our VSTGUI 0..1 or -1..1 values to the right scale and
- * 2: Send an outbound queue event to the lock free ui -> engine queue with
- *    the info.
+ * 1; Scale our VSTGUI 0..1 values to the parameter's range (from ClapSawDemo::paramDefs) and
+ * 2: Set it in the outbound ui -> engine channel, where it replaces any value the engine
+ *    hasn't picked up yet.
  */
 void ClapSawDemoEditor::valueChanged(VSTGUI::CControl *c)
 {
     auto t = (tags)c->getTag();
-    auto q = ClapSawDemo::FromUI();
-    q.id = paramIdFromTag(t);
-    q.type = ClapSawDemo::FromUI::MType::ADJUST_VALUE;
-    auto send = true;
-    switch (t)
-    {
-        // 0..1
-    case tags::resonance:
-    case tags::vca:
-    case tags::env_a:
-    case tags::env_r:
-    {
-        q.value = c->getValue();
-        break;
-    }
-    case tags::unisp:
-    {
-        q.value = c->getValue() * 100.0;
-        break;
-    }
-    case tags::oscdetune:
-    {
-        q.value = c->getValue() * 200.0;
-        break;
-    }
-    case tags::unict:
-    {
-        q.value = c->getValue() * SawDemoVoice::max_uni;
-        break;
-    }
-    case tags::cutoff:
-    {
-        q.value = c->getValue() * 126 + 1;
-    }
-    }
-    if (send)
+
+    // The sliders all run 0...1, which the parameter table maps onto each parameter's range
+    auto idx = ClapSawDemo::paramIndex.indexOf(paramIdFromTag(t));
+    if (idx >= 0)
     {
-        outbound.try_enqueue(q);
+        outbound.params.set(idx, ClapSawDemo::paramDefs[idx].denormalise(c->getValue()));
         paramRequestFlush();
     }
 }
 
 /*
  * Similarly, beginEdit / endEdit need to map the gui tag to a param id and then
- * enqueue an outbound event.
+ * send an outbound message.
  */
 void ClapSawDemoEditor::beginEdit(int32_t tag)
 {
-    auto q = ClapSawDemo::FromUI();
-    q.id = paramIdFromTag(tag);
-    q.type = ClapSawDemo::FromUI::MType::BEGIN_EDIT;
-    outbound.try_enqueue(q);
+    auto id = paramIdFromTag(tag);
+    outbound.messages.push(ClapSawDemo::FromUI::BEGIN_EDIT, &id, sizeof(id));
     paramRequestFlush();
 }
 void ClapSawDemoEditor::endEdit(int32_t tag)
 {
-    auto q = ClapSawDemo::FromUI();
-    q.id = paramIdFromTag(tag);
-    q.type = ClapSawDemo::FromUI::MType::END_EDIT;
-    outbound.try_enqueue(q);
+    auto id = paramIdFromTag(tag);
+    outbound.messages.push(ClapSawDemo::FromUI::END_EDIT, &id, sizeof(id));
     paramRequestFlush();
 }
 
 /*
- * The ::idle method polls the inbound queue and value-based data structure,
+ * The ::idle method sweeps the parameter mirror, inbound ring and value-based data structure,
  * responds by rescaling values and setting them on UI elements, and then invalidates
- * the appropriate UI control.
+ * the appropriate UI control. Each parameter changed since the last idle comes out of
+ * the mirror once, with its latest value, so the cost here is the number of changed
+ * parameters however many automation events the engine saw.
  */
 void ClapSawDemoEditor::idle()
 {
-    ClapSawDemo::ToUI r;
-    while (inbound.try_dequeue(r))
-    {
-        if (r.type == ClapSawDemo::ToUI::MType::PARAM_VALUE)
+    paramMirror.drain(
+        [this](int idx, double value)
         {
-            auto q = paramIdToCControl.find(r.id);
-
+            auto q = paramIdToCControl.find(ClapSawDemo::paramDefs[idx].id);
             if (q != paramIdToCControl.end())
             {
                 auto cc = q->second;
-                auto val = r.value;
-
-                switch (r.id)
-                {
-                case ClapSawDemo::pmUnisonSpread:
-                    val = val / 100.0;
-                    break;
-                case ClapSawDemo::pmOscDetune:
-                    val = val / 200.0;
-                    break;
-                case ClapSawDemo::pmUnisonCount:
-                    val = val / SawDemoVoice::max_uni;
-                    break;
-                case ClapSawDemo::pmCutoff:
-                    val = (val - 1) / 126.0;
-                    break;
-
-                default:
-                    break;
-                }
-                cc->setValue(val);
+                cc->setValue(ClapSawDemo::paramDefs[idx].normalise(value));
                 cc->invalid();
             }
-        }
-    }
+        });
+
+    // We don't display notes yet, but we have to keep the ring moving
+    inbound.drain([](uint16_t, const void *, uint16_t) {});
 
     if (synthData.updateCount != lastDataUpdate)
     {
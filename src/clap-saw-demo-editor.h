@@ -6,6 +6,7 @@
 #define CLAP_SAW_DEMO_EDITOR_H
 #include <vstgui/vstgui.h>
 #include "clap-saw-demo.h"
+#include <unordered_map>
 
 namespace sst::clap_saw_demo
 {
@@ -18,13 +19,15 @@ struct ClapSawDemoBackground;
  */
 struct ClapSawDemoEditor : public VSTGUI::VSTGUIEditorInterface, public VSTGUI::IControlListener
 {
-    ClapSawDemo::SynthToUI_Queue_t &inbound;
-    ClapSawDemo::UIToSynth_Queue_t &outbound;
+    ClapSawDemo::ParamMirror_t &paramMirror;
+    ClapSawDemo::SynthToUI_Ring_t &inbound;
+    ClapSawDemo::UIToSynth_Channel_t &outbound;
     const ClapSawDemo::DataCopyForUI &synthData;
     std::function<void()> paramRequestFlush;
 
-    ClapSawDemoEditor(ClapSawDemo::SynthToUI_Queue_t &, ClapSawDemo::UIToSynth_Queue_t &,
-                      const ClapSawDemo::DataCopyForUI &, std::function<void()>);
+    ClapSawDemoEditor(ClapSawDemo::ParamMirror_t &, ClapSawDemo::SynthToUI_Ring_t &,
+                      ClapSawDemo::UIToSynth_Channel_t &, const ClapSawDemo::DataCopyForUI &,
+                      std::function<void()>);
     ~ClapSawDemoEditor() override;
 
     void haltIdleTimer();
@@ -14,14 +14,18 @@
  * through to expose ClapSawDemo::desc and create a ClapSawDemo plugin instance using
  * the helper classes.
  *
- * For more information on this mechanism, see include/clap/entry.h
+ * For more information on this mechanism, see include/clap/entry.h. Alongside the plugin
+ * factory we also expose a preset discovery factory (include/clap/factory/preset-discovery.h)
+ * so hosts can index our preset banks.
  */
 
 #include "clap-saw-demo.h"
 
 #include <iostream>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <string>
 
 namespace sst::clap_saw_demo::pluginentry
 {
@@ -53,9 +57,132 @@ const CLAP_EXPORT struct clap_plugin_factory clap_saw_demo_factory = {
     sst::clap_saw_demo::pluginentry::clap_get_plugin_descriptor,
     sst::clap_saw_demo::pluginentry::clap_create_plugin,
 };
+/*
+ * The preset discovery factory tells the host's preset indexer where our preset banks are
+ * (see preset-bank.h) and, when it asks, what is in each one. It has a single provider which
+ * declares the bank file type and the bank directory, and answers get_metadata by mapping
+ * the bank and reading its name index; the presets themselves are never parsed here. Each
+ * preset's load key is its number in the bank, which the indexer hands back to
+ * ClapSawDemo::presetLoadFromLocation when the user picks it.
+ */
+static const clap_preset_discovery_provider_descriptor preset_provider_desc = {
+    CLAP_VERSION, "org.surge-synth-team.clap-saw-demo.banks", "Clap Saw Demo Banks",
+    "Surge Synth Team"};
+
+struct PresetProvider
+{
+    clap_preset_discovery_provider provider;
+    const clap_preset_discovery_indexer *indexer;
+    std::string bankDirectory;
+};
+
+static PresetProvider *fromProvider(const clap_preset_discovery_provider *p)
+{
+    return static_cast<PresetProvider *>(p->provider_data);
+}
+
+static bool preset_provider_init(const clap_preset_discovery_provider *p)
+{
+    auto *pp = fromProvider(p);
+    auto *ix = pp->indexer;
+
+    static const clap_preset_discovery_filetype bankType = {
+        "Clap Saw Demo Bank", "A file of Clap Saw Demo presets", PresetBank::fileExtension};
+    if (!ix->declare_filetype(ix, &bankType))
+        return false;
+
+    // No bank directory (no home directory, say) just means we have nothing to offer
+    pp->bankDirectory = presetBankDirectory();
+    if (pp->bankDirectory.empty())
+        return true;
+
+    clap_preset_discovery_location loc;
+    loc.flags = CLAP_PRESET_DISCOVERY_IS_USER_CONTENT;
+    loc.name = "Clap Saw Demo Banks";
+    loc.kind = CLAP_PRESET_DISCOVERY_LOCATION_FILE;
+    loc.location = pp->bankDirectory.c_str();
+    return ix->declare_location(ix, &loc);
+}
+
+static void preset_provider_destroy(const clap_preset_discovery_provider *p)
+{
+    delete fromProvider(p);
+}
+
+static bool preset_provider_get_metadata(const clap_preset_discovery_provider *p,
+                                         uint32_t location_kind, const char *location,
+                                         const clap_preset_discovery_metadata_receiver *r)
+{
+    if (location_kind != CLAP_PRESET_DISCOVERY_LOCATION_FILE || !location)
+        return false;
+
+    PresetBank bank;
+    if (!bank.open(location))
+    {
+        r->on_error(r, bank.osError(), bank.errorMessage());
+        return false;
+    }
+
+    static const clap_universal_plugin_id pluginId = {"clap", ClapSawDemo::desc.id};
+    for (uint32_t i = 0; i < bank.presetCount(); ++i)
+    {
+        auto *name = bank.name(i);
+        if (!name)
+            continue; // a damaged entry; skip it and index the rest
+
+        char loadKey[16];
+        snprintf(loadKey, sizeof(loadKey), "%u", i);
+        if (!r->begin_preset(r, name, loadKey))
+            break;
+        r->add_plugin_id(r, &pluginId);
+    }
+    return true;
+}
+
+static const void *preset_provider_get_extension(const clap_preset_discovery_provider *,
+                                                 const char *)
+{
+    return nullptr;
+}
+
+uint32_t preset_factory_count(const clap_preset_discovery_factory *) { return 1; }
+const clap_preset_discovery_provider_descriptor *
+preset_factory_get_descriptor(const clap_preset_discovery_factory *, uint32_t index)
+{
+    return index == 0 ? &preset_provider_desc : nullptr;
+}
+const clap_preset_discovery_provider *
+preset_factory_create(const clap_preset_discovery_factory *,
+                      const clap_preset_discovery_indexer *indexer, const char *provider_id)
+{
+    if (strcmp(provider_id, preset_provider_desc.id))
+        return nullptr;
+
+    // Like the plugin, this is freed by the host calling destroy
+    auto *pp = new PresetProvider();
+    pp->indexer = indexer;
+    pp->provider.desc = &preset_provider_desc;
+    pp->provider.provider_data = pp;
+    pp->provider.init = preset_provider_init;
+    pp->provider.destroy = preset_provider_destroy;
+    pp->provider.get_metadata = preset_provider_get_metadata;
+    pp->provider.get_extension = preset_provider_get_extension;
+    return &pp->provider;
+}
+
+const CLAP_EXPORT struct clap_preset_discovery_factory clap_saw_demo_preset_discovery_factory = {
+    sst::clap_saw_demo::pluginentry::preset_factory_count,
+    sst::clap_saw_demo::pluginentry::preset_factory_get_descriptor,
+    sst::clap_saw_demo::pluginentry::preset_factory_create,
+};
+
 static const void *get_factory(const char *factory_id)
 {
-    return (!strcmp(factory_id, CLAP_PLUGIN_FACTORY_ID)) ? &clap_saw_demo_factory : nullptr;
+    if (!strcmp(factory_id, CLAP_PLUGIN_FACTORY_ID))
+        return &clap_saw_demo_factory;
+    if (!strcmp(factory_id, CLAP_PRESET_DISCOVERY_FACTORY_ID))
+        return &clap_saw_demo_preset_discovery_factory;
+    return nullptr;
 }
 
 // clap_init and clap_deinit are required to be fast, but we have nothing we need to do here
@@ -5,10 +5,13 @@
  */
 
 #include "clap-saw-demo.h"
+#include "voice-quad.h"
 #include <iostream>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <algorithm>
+#include <thread>
 
 // Eject the core symbols for the plugin
 #include <clap/helpers/plugin.hh>
@@ -26,16 +29,13 @@ ClapSawDemo::ClapSawDemo(const clap_host *host)
                             clap::helpers::CheckingLevel::Maximal>(&desc, host)
 {
     _DBGCOUT << "Constructing ClapSawDemo" << std::endl;
-    paramToValue[pmUnisonCount] = &unisonCount;
-    paramToValue[pmUnisonSpread] = &unisonSpread;
-    paramToValue[pmOscDetune] = &oscDetune;
-    paramToValue[pmAmpAttack] = &ampAttack;
-    paramToValue[pmAmpRelease] = &ampRelease;
-    paramToValue[pmAmpIsGate] = &ampIsGate;
-    paramToValue[pmCutoff] = &cutoff;
-    paramToValue[pmResonance] = &resonance;
-    paramToValue[pmPreFilterVCA] = &preFilterVCA;
-    paramToValue[pmFilterMode] = &filterMode;
+    for (int i = 0; i < nParams; ++i)
+    {
+        paramValues[i] = paramDefs[i].defaultValue;
+        paramMirror.store(i, paramValues[i]);
+    }
+
+    snapSmoothers();
 
     terminatedVoices.reserve(max_voices * 4);
 }
@@ -60,6 +60,60 @@ clap_plugin_descriptor ClapSawDemo::desc = {CLAP_VERSION,
                                             "1.0.0",
                                             "A simple sawtooth synth to show CLAP features.",
                                             features};
+bool ClapSawDemo::activate(double sampleRate, uint32_t minFrameCount,
+                           uint32_t maxFrameCount) noexcept
+{
+    // A state loaded while we were last active may not have reached paramValues yet, and
+    // everything below has to agree with the mirror checkActivateParams compares against
+    adoptStateSnapshot();
+
+    auto priorCapacity = voices.getCapacity();
+    auto priorLatency = decimator.latency();
+    auto offline = (renderMode == CLAP_RENDER_OFFLINE);
+    activatedOffline = offline;
+
+    oversampling = wantedOversampling();
+    decimator.reset(oversampling);
+
+    voices.reset((int)param<pmPolyphony>());
+    voices.setSampleRate(sampleRate * oversampling);
+    voices.setExactMath(offline);
+
+    this->sampleRate = sampleRate;
+    snapSmoothers();
+    controlCountdown = 0;
+    profiler.reset(sampleRate);
+
+    // One worker per core, less the host's audio thread which works alongside them
+    if (offline)
+        renderPool = RenderPool::acquireShared(
+            std::min((int)std::thread::hardware_concurrency() - 1, maxRenderTasks - 1));
+    else
+        renderPool.reset();
+
+    if (voices.getCapacity() != priorCapacity && _host.canUseVoiceInfo())
+        _host.voiceInfoChanged();
+    if (decimator.latency() != priorLatency && _host.canUseLatency())
+        _host.latencyChanged();
+    updateTail();
+    return true;
+}
+
+void ClapSawDemo::deactivate() noexcept
+{
+    renderPool.reset();
+
+    // With profiling enabled, summarise the audio thread's activity since activate
+    profiler.report(std::cout);
+}
+
+bool ClapSawDemo::renderSetMode(clap_plugin_render_mode mode) noexcept
+{
+    renderMode = mode;
+    checkActivateParams();
+    return true;
+}
+
 /*
  * PARAMETER SETUP SECTION
  */
@@ -69,116 +123,27 @@ bool ClapSawDemo::paramsInfo(uint32_t paramIndex, clap_param_info *info) const n
         return false;
 
     /*
-     * Our job is to populate the clap_param_info. We set each of our parameters as AUTOMATABLE
-     * and then begin setting per-parameter features.
-     */
-    info->flags = CLAP_PARAM_IS_AUTOMATABLE;
-
-    /*
-     * These constants activate polyphonic modulatability on a parameter. Not all the params here
-     * support that
+     * Our job is to populate the clap_param_info, which is just a copy of our entry in the
+     * parameter table
      */
-    auto mod = CLAP_PARAM_IS_MODULATABLE | CLAP_PARAM_IS_MODULATABLE_PER_NOTE_ID |
-               CLAP_PARAM_IS_MODULATABLE_PER_KEY;
-
-    switch (paramIndex)
-    {
-    case 0:
-        info->id = pmUnisonCount;
-        strncpy(info->name, "Unison Count", CLAP_NAME_SIZE);
-        strncpy(info->module, "Oscillator", CLAP_NAME_SIZE);
-        info->min_value = 1;
-        info->max_value = SawDemoVoice::max_uni;
-        info->default_value = 3;
-        info->flags |= CLAP_PARAM_IS_STEPPED;
-        break;
-    case 1:
-        info->id = pmUnisonSpread;
-        strncpy(info->name, "Unison Spread in Cents", CLAP_NAME_SIZE);
-        strncpy(info->module, "Oscillator", CLAP_NAME_SIZE);
-        info->min_value = 0;
-        info->max_value = 100;
-        info->default_value = 10;
-        info->flags |= mod;
-        break;
-    case 2:
-        info->id = pmOscDetune;
-        strncpy(info->name, "Oscillator Detuning (in cents)", CLAP_NAME_SIZE);
-        strncpy(info->module, "Oscillator", CLAP_NAME_SIZE);
-        info->min_value = -200;
-        info->max_value = 200;
-        info->default_value = 0;
-        info->flags |= mod;
-        break;
-    case 3:
-        info->id = pmAmpAttack;
-        strncpy(info->name, "Amplitude Attack (s)", CLAP_NAME_SIZE);
-        strncpy(info->module, "Amplitude Envelope Generator", CLAP_NAME_SIZE);
-        info->min_value = 0;
-        info->max_value = 1;
-        info->default_value = 0.01;
-        break;
-    case 4:
-        info->id = pmAmpRelease;
-        strncpy(info->name, "Amplitude Release (s)", CLAP_NAME_SIZE);
-        strncpy(info->module, "Amplitude Envelope Generator", CLAP_NAME_SIZE);
-        info->min_value = 0;
-        info->max_value = 1;
-        info->default_value = 0.2;
-        break;
-    case 5:
-        info->id = pmAmpIsGate;
-        strncpy(info->name, "Deactivate Amp Envelope", CLAP_NAME_SIZE);
-        strncpy(info->module, "Amplitude Envelope Generator", CLAP_NAME_SIZE);
-        info->min_value = 0;
-        info->max_value = 1;
-        info->default_value = 0;
-        info->flags |= CLAP_PARAM_IS_STEPPED;
-        break;
-    case 6:
-        info->id = pmPreFilterVCA;
-        strncpy(info->name, "Pre Filter VCA", CLAP_NAME_SIZE);
-        strncpy(info->module, "Filter", CLAP_NAME_SIZE);
-        info->min_value = 0;
-        info->max_value = 1;
-        info->default_value = 1;
-        info->flags |= mod;
-        break;
-    case 7:
-        info->id = pmCutoff;
-        strncpy(info->name, "Cutoff in Keys", CLAP_NAME_SIZE);
-        strncpy(info->module, "Filter", CLAP_NAME_SIZE);
-        info->min_value = 1;
-        info->max_value = 127;
-        info->default_value = 69;
-        info->flags |= mod;
-        break;
-    case 8:
-        info->id = pmResonance;
-        strncpy(info->name, "Resonance", CLAP_NAME_SIZE);
-        strncpy(info->module, "Filter", CLAP_NAME_SIZE);
-        info->min_value = 0.0;
-        info->max_value = 1.0;
-        info->default_value = 0.7;
-        info->flags |= mod;
-        break;
-    case 9:
-        info->id = pmFilterMode;
-        strncpy(info->name, "Filter Type", CLAP_NAME_SIZE);
-        strncpy(info->module, "Filter", CLAP_NAME_SIZE);
-        info->min_value = SawDemoVoice::StereoSimperSVF::Mode::LP;
-        info->max_value = SawDemoVoice::StereoSimperSVF::Mode::ALL;
-        info->default_value = 0;
-        info->flags |= CLAP_PARAM_IS_STEPPED;
-        break;
-    }
+    const auto &pd = paramDefs[paramIndex];
+    info->id = pd.id;
+    info->flags = pd.flags;
+    snprintf(info->name, CLAP_NAME_SIZE, "%s", pd.name);
+    snprintf(info->module, CLAP_PATH_SIZE, "%s", pd.module);
+    info->min_value = pd.minValue;
+    info->max_value = pd.maxValue;
+    info->default_value = pd.defaultValue;
     return true;
 }
 
 bool ClapSawDemo::paramsValueToText(clap_id paramId, double value, char *display,
                                     uint32_t size) noexcept
 {
-    auto pid = (paramIds)paramId;
+    auto idx = paramIndex.indexOf(paramId);
+    if (idx < 0)
+        return false;
+
     std::string sValue{"ERROR"};
     auto n2s = [](auto n)
     {
@@ -186,36 +151,33 @@ bool ClapSawDemo::paramsValueToText(clap_id paramId, double value, char *display
         oss << std::setprecision(6) << n;
         return oss.str();
     };
-    switch (pid)
+    switch (paramDefs[idx].format)
     {
-    case pmResonance:
-    case pmPreFilterVCA:
+    case ParamFormat::Plain:
         sValue = n2s(value);
         break;
-    case pmAmpRelease:
-    case pmAmpAttack:
+    case ParamFormat::Seconds:
         sValue = n2s(scaleTimeParamToSeconds(value)) + " s";
         break;
-    case pmUnisonCount:
+    case ParamFormat::Voices:
     {
         int vc = static_cast<int>(value);
         sValue = n2s(vc) + (vc == 1 ? " voice" : " voices");
         break;
     }
-    case pmUnisonSpread:
-    case pmOscDetune:
+    case ParamFormat::Cents:
         sValue = n2s(value) + " cents";
         break;
-    case pmAmpIsGate:
+    case ParamFormat::Gate:
         sValue = value > 0.5 ? "AEG Bypassed" : "AEG On";
         break;
-    case pmCutoff:
+    case ParamFormat::Keys:
     {
         auto co = 440 * pow(2.0, (value - 69) / 12);
         sValue = n2s(co) + " Hz";
         break;
     }
-    case pmFilterMode:
+    case ParamFormat::FilterMode:
     {
         auto fm = (SawDemoVoice::StereoSimperSVF::Mode) static_cast<int>(value);
         switch (fm)
@@ -241,6 +203,34 @@ bool ClapSawDemo::paramsValueToText(clap_id paramId, double value, char *display
         }
         break;
     }
+    case ParamFormat::Milliseconds:
+        sValue = n2s(value) + " ms";
+        break;
+    case ParamFormat::Oversampling:
+    {
+        int om = std::clamp(static_cast<int>(value), 0, 2);
+        sValue = om == 0 ? "Off" : n2s(1 << om) + "x";
+        break;
+    }
+    case ParamFormat::StealMode:
+    {
+        switch ((VoiceStealMode) static_cast<int>(value))
+        {
+        case STEAL_OLDEST:
+            sValue = "Oldest";
+            break;
+        case STEAL_QUIETEST:
+            sValue = "Quietest";
+            break;
+        case STEAL_RELEASING_FIRST:
+            sValue = "Releasing First";
+            break;
+        case STEAL_SAME_KEY:
+            sValue = "Same Key";
+            break;
+        }
+        break;
+    }
     }
 
     strncpy(display, sValue.c_str(), size);
@@ -250,34 +240,32 @@ bool ClapSawDemo::paramsValueToText(clap_id paramId, double value, char *display
 
 bool ClapSawDemo::paramsTextToValue(clap_id paramId, const char *display, double *value) noexcept
 {
-    switch (paramId)
+    auto idx = paramIndex.indexOf(paramId);
+    if (idx < 0)
+        return false;
+
+    const auto &pd = paramDefs[idx];
+    switch (pd.format)
     {
-    case pmResonance:
-    case pmPreFilterVCA:
-        *value = std::clamp(std::atof(display), 0., 1.);
+    case ParamFormat::Plain:
+    case ParamFormat::Cents:
+    case ParamFormat::Milliseconds:
+        *value = std::clamp(std::atof(display), pd.minValue, pd.maxValue);
         return true;
-        break;
-    case pmAmpRelease:
-    case pmAmpAttack:
+    case ParamFormat::Voices:
+        *value = std::clamp((double)std::atoi(display), pd.minValue, pd.maxValue);
+        return true;
+    case ParamFormat::Seconds:
         *value = scaleSecondsToTimeParam(std::atof(display));
         return true;
-        break;
-    case pmUnisonCount:
+    case ParamFormat::Oversampling:
     {
-        *value = std::clamp(std::atoi(display), 1, 7);
+        // "2x" and "4x", and anything else (like "Off") is no oversampling
+        auto factor = std::atoi(display);
+        *value = factor >= 4 ? 2 : (factor >= 2 ? 1 : 0);
         return true;
-        break;
     }
-    case pmUnisonSpread:
-        *value = std::clamp(std::atof(display), 0., 100.);
-        return true;
-        break;
-
-    case pmOscDetune:
-        *value = std::clamp(std::atof(display), -200.0, 200.0);
-        return true;
-        break;
-    case pmCutoff:
+    case ParamFormat::Keys:
     {
         // auto co = 440 * pow(2.0, (value - 69) / 12);
         // log2(co/440) = (value - 69)/12
@@ -286,13 +274,12 @@ bool ClapSawDemo::paramsTextToValue(clap_id paramId, const char *display, double
         auto cohz = std::clamp(std::atof(display), 1.0, 25000.0);
         *value = log2(cohz / 440.0) * 12 + 69;
         return true;
-        break;
     }
-        // Skip these two. You get the idea
-    case pmFilterMode:
-    case pmAmpIsGate:
+        // Skip these three. You get the idea
+    case ParamFormat::FilterMode:
+    case ParamFormat::Gate:
+    case ParamFormat::StealMode:
         return false;
-        break;
     }
 
     return false;
@@ -339,15 +326,17 @@ bool ClapSawDemo::notePortsInfo(uint32_t index, bool isInput,
  *
  * In the ClapSawDemo, our process loop has 3 basic stages
  *
- * 1. See if the UI has sent us any events on the thread-safe UI Queue (
+ * 1. See if the UI has sent us any events on the thread-safe UI channel (
  *    see the discussion in the clap header file for this structure), apply them
  *    to my internal state, and generate CLAP changed messages
  *
- * 2. Iterate over samples rendering the voices, and if an inbound event is coincident
- *    with a sample, process that event for note on, modulation, parameter automation, and so on
+ * 2. Walk the block from event to event. Each event is applied at its sample (note on,
+ *    modulation, parameter automation, and so on) and the voices are rendered as a block
+ *    across the span until the next event
  *
- * 3. Detect any voices which have terminated in the block (their state has become 'NEWLY_OFF'),
- *    update them to 'OFF' and send a CLAP NOTE_END event to terminate any polyphonic modulators.
+ * 3. At the end of each span, detect any voices which have terminated (their state has become
+ *    'NEWLY_OFF'), update them to 'OFF' and send a CLAP NOTE_END event to terminate any
+ *    polyphonic modulators.
  */
 clap_process_status ClapSawDemo::process(const clap_process *process) noexcept
 {
@@ -355,6 +344,21 @@ clap_process_status ClapSawDemo::process(const clap_process *process) noexcept
     if (process->audio_outputs_count <= 0)
         return CLAP_PROCESS_SLEEP;
 
+    // Flush denormals to zero until we return; see denormals.h
+    ScopedDenormalFlush denormalFlush;
+
+    profiler.beginBlock(process->steady_time, process->frames_count);
+
+    // A state loaded since the last block switches over here, before any of its events
+    adoptStateSnapshot();
+
+    if (tailFrames != reportedTailFrames)
+    {
+        reportedTailFrames = tailFrames;
+        if (_host.canUseTail())
+            _host.tailChanged();
+    }
+
     /*
      * Stage 1:
      *
@@ -383,14 +387,32 @@ clap_process_status ClapSawDemo::process(const clap_process *process) noexcept
      * CLAP has a single inbound event loop where every event is time stamped with
      * a sample id. This means the process loop can easily interleave note and parameter
      * and other events with audio generation. Here we do everything completely sample accurately
-     * by maintaining a pointer to the 'nextEvent' which we check at every sample.
+     * by maintaining a pointer to the 'nextEvent', applying it at its sample, and rendering
+     * the voices in a block up to the following event.
      */
     float **out = process->audio_outputs[0].data32;
     auto chans = process->audio_outputs->channel_count;
+    uint32_t frames = process->frames_count;
 
     auto ev = process->in_events;
     auto sz = ev->size(ev);
 
+    /*
+     * The idle fast path: with no events and the engine silent (see isSilent) the block is
+     * silence, so write it with a memset per channel, mark every channel constant so the host
+     * can skip it too, and sleep.
+     */
+    if (sz == 0 && isSilent())
+    {
+        for (uint32_t ch = 0; ch < chans; ++ch)
+            memset(out[ch], 0, frames * sizeof(float));
+        process->audio_outputs[0].constant_mask = chans >= 64 ? ~0ULL : (1ULL << chans) - 1;
+        skipControlFrames(frames);
+        profiler.endBlock();
+        return CLAP_PROCESS_SLEEP;
+    }
+    process->audio_outputs[0].constant_mask = 0;
+
     // This pointer is the sentinel to our next event which we advance once an event is processed
     const clap_event_header_t *nextEvent{nullptr};
     uint32_t nextEventIndex{0};
@@ -399,73 +421,123 @@ clap_process_status ClapSawDemo::process(const clap_process *process) noexcept
         nextEvent = ev->get(ev, nextEventIndex);
     }
 
-    for (int i = 0; i < process->frames_count; ++i)
+    auto advanceEvent = [&]()
+    {
+        nextEventIndex++;
+        if (nextEventIndex >= sz)
+            nextEvent = nullptr;
+        else
+            nextEvent = ev->get(ev, nextEventIndex);
+    };
+
+    for (uint32_t i = 0; i < frames;)
     {
-        // Do I have an event to process. Note that multiple events
-        // can occur on the same sample, hence 'while' not 'if'
-        while (nextEvent && nextEvent->time == i)
+        // Do I have an event to process. Note that multiple events can occur on the same
+        // sample, hence 'while' not 'if'. We take anything stamped at or before the cursor
+        // so an out of order event from a misbehaving host is applied late, not dropped.
+        if (nextEvent && nextEvent->time <= i)
         {
-            // handleInboundEvent is a separate function which adjusts the state based
-            // on event type. We segregate it for clarity but you really should read it!
-            handleInboundEvent(nextEvent);
-            nextEventIndex++;
-            if (nextEventIndex >= sz)
-                nextEvent = nullptr;
-            else
-                nextEvent = ev->get(ev, nextEventIndex);
+            profiling::ScopeTimer timer(profiler, profiling::tmEvents);
+            while (nextEvent && nextEvent->time <= i)
+            {
+                // handleInboundEvent is a separate function which adjusts the state based
+                // on event type. We segregate it for clarity but you really should read it!
+                handleInboundEvent(nextEvent);
+                advanceEvent();
+            }
         }
 
-        // This is a simple accumulator of output across our active voices.
-        // See saw-voice.h for information on the individual voice.
-        for (int ch = 0; ch < chans; ++ch)
+        // Nothing changes between now and the next event, so we can render every
+        // voice across that whole segment in one block call. The loop above means
+        // the next event is strictly after i, so the segment is never empty.
+        uint32_t segEnd = frames;
+        if (nextEvent && nextEvent->time < frames)
+            segEnd = nextEvent->time;
+
         {
-            out[ch][i] = 0.f;
+            profiling::ScopeTimer timer(profiler, profiling::tmRender);
+            renderVoicesToOutput(out, chans, i, (int)(segEnd - i));
         }
-        for (auto &v : voices)
+
+        /*
+         * Stage 3, which we run at the end of each segment, is to inform the host of our
+         * terminated voices at the sample they ended, and to free them so a later note in
+         * this block can use the slot. Voices stolen or ended by the events at i end at i.
+         */
+        reportTerminatedVoices(process->out_events, i);
+        i = segEnd;
+    }
+
+    // Events stamped past the end of the block still have to be applied
+    if (nextEvent)
+    {
+        profiling::ScopeTimer timer(profiler, profiling::tmEvents);
+        while (nextEvent)
         {
-            if (v.isPlaying())
-            {
-                v.step();
-                if (chans >= 2)
-                {
-                    out[0][i] += v.L;
-                    out[1][i] += v.R;
-                }
-                else if (chans == 1)
-                {
-                    out[0][i] += (v.L + v.R) * 0.5;
-                }
-            }
+            handleInboundEvent(nextEvent);
+            advanceEvent();
         }
     }
+    reportTerminatedVoices(process->out_events, frames > 0 ? frames - 1 : 0);
+
+    // We should have gotten all the events
+    assert(!nextEvent);
+
+    sendNotesToUI();
+    profiler.endBlock();
 
     /*
-     * Stage 3 is to inform the host of our terminated voices.
-     *
-     * This allows hosts which support polyphonic modulation to terminate those
-     * modulators, and it is also the reason we have the NEWLY_OFF state in addition
-     * to the OFF state.
-     *
-     * Note that there are two ways to enter the terminatedVoices array. The first
-     * is here through natural state transition to NEWLY_OFF and the second is in
-     * handleNoteOn when we steal a voice.
+     * A little optimization - if we are completely silent (no voices, no smoother still
+     * ramping, and nothing left in the decimator, see isSilent) we can return
+     * CLAP_PROCESS_SLEEP until we get the next event and our host can optionally skip
+     * processing. Otherwise continue, but let the host stop calling us once our output is
+     * quiet. Every way a voice can sound again starts with an event, which wakes us.
      */
-    for (auto &v : voices)
-    {
-        if (v.state == SawDemoVoice::NEWLY_OFF)
+    if (isSilent())
+        return CLAP_PROCESS_SLEEP;
+
+    return CLAP_PROCESS_CONTINUE_IF_NOT_QUIET;
+}
+
+/*
+ * reportTerminatedVoices informs the host of our terminated voices.
+ *
+ * This allows hosts which support polyphonic modulation to terminate those
+ * modulators, and it is also the reason we have the NEWLY_OFF state in addition
+ * to the OFF state.
+ *
+ * Note that there are two ways to enter the terminatedVoices array. The first
+ * is here through natural state transition to NEWLY_OFF and the second is in
+ * handleNoteOn when we steal a voice. A voice which ended while rendering knows the
+ * sample it ended at (endedAt); one stolen or released into NEWLY_OFF by an event ends
+ * at eventTime. Output events have to be in time order, so we sort them first.
+ */
+void ClapSawDemo::reportTerminatedVoices(const clap_output_events *ov, uint32_t eventTime)
+{
+    profiling::ScopeTimer timer(profiler, profiling::tmTerminate);
+
+    for (auto &t : terminatedVoices)
+        std::get<0>(t) = eventTime;
+    voices.forEachInUse(
+        [this, eventTime](int idx)
         {
-            terminatedVoices.emplace_back(v.portid, v.channel, v.key, v.note_id);
-            v.state = SawDemoVoice::OFF;
-        }
-    }
+            const auto &v = voices.voice(idx);
+            if (v.state == SawDemoVoice::NEWLY_OFF)
+            {
+                const auto &c = voices.controls(idx);
+                auto time = v.endedAt >= 0 ? (uint32_t)v.endedAt : eventTime;
+                terminatedVoices.emplace_back(time, c.portid, c.channel, c.key, c.note_id);
+                voices.free(idx);
+            }
+        });
+    std::sort(terminatedVoices.begin(), terminatedVoices.end());
 
-    for (const auto &[portid, channel, key, note_id] : terminatedVoices)
+    for (const auto &[time, portid, channel, key, note_id] : terminatedVoices)
     {
-        auto ov = process->out_events;
         auto evt = clap_event_note();
         evt.header.size = sizeof(clap_event_note);
         evt.header.type = (uint16_t)CLAP_EVENT_NOTE_END;
-        evt.header.time = process->frames_count - 1;
+        evt.header.time = time;
         evt.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
         evt.header.flags = 0;
 
@@ -475,7 +547,8 @@ clap_process_status ClapSawDemo::process(const clap_process *process) noexcept
         evt.note_id = note_id;
         evt.velocity = 0.0;
 
-        ov->try_push(ov, &(evt.header));
+        if (!ov->try_push(ov, &(evt.header)))
+            profiler.count(profiling::ctTryPushFailed);
 
 #if HAS_GUI
         dataCopyForUI.updateCount++;
@@ -483,22 +556,167 @@ clap_process_status ClapSawDemo::process(const clap_process *process) noexcept
 #endif
     }
     terminatedVoices.clear();
+}
 
-    // We should have gotten all the events
-    assert(!nextEvent);
+/*
+ * renderVoicesToOutput sums every playing voice into the output channels from sample
+ * `offset` for `frames` samples. This is a simple accumulator of output across our active
+ * voices. See saw-voice.h for information on the individual voice.
+ *
+ * Voices are rendered four at a time through VoiceQuad (voice-quad.h) so their filters run
+ * together in one SIMD register, into a stereo bus which we then copy to the outputs.
+ *
+ * The playing voices are split into RenderTasks (see clap-saw-demo.h) which render into
+ * their own buses, and we then sum those buses in task order. With enough tasks they run in
+ * parallel on the host's thread pool if it has one (or our RenderPool when bouncing
+ * offline). We dispatch once per span of up to renderSpanFrames, not once per control tick:
+ * planControlChunks runs the smoothers across the span first and each task pushes the values
+ * into its own voices as it reaches each chunk.
+ *
+ * When bouncing offline the voices run oversampled, so each span renders oversampling times
+ * as many voice frames and the decimator reduces the bus to the output rate before the copy.
+ */
+void ClapSawDemo::renderVoicesToOutput(float **out, uint32_t chans, uint32_t offset, int frames)
+{
+    while (frames > 0)
+    {
+        // n output frames, which is vn frames at the voices' (possibly oversampled) rate
+        auto n = planControlChunks(frames);
+        auto vn = n * oversampling;
+        spanOffset = offset;
+
+        alignas(16) float busL[renderSpanFrames], busR[renderSpanFrames];
+        memset(busL, 0, vn * sizeof(float));
+        memset(busR, 0, vn * sizeof(float));
+
+        int nTasks{0};
+        voices.forEachPlaying(
+            [&](int idx)
+            {
+                if (nTasks == 0 || renderTasks[nTasks - 1].count == voicesPerTask)
+                    renderTasks[nTasks++].count = 0;
+                auto &t = renderTasks[nTasks - 1];
+                t.voices[t.count++] = idx;
+            });
+
+        auto ranOnPool{false};
+        if (nTasks >= minTasksForPool)
+        {
+            ranOnPool = _host.canUseThreadPool() && _host.threadPoolRequestExec(nTasks);
+            auto runTask = [](void *c, int t) { static_cast<ClapSawDemo *>(c)->renderTask(t); };
+            if (!ranOnPool && renderMode == CLAP_RENDER_OFFLINE)
+                ranOnPool = renderPool && renderPool->run(nTasks, runTask, this);
+        }
+        if (!ranOnPool)
+        {
+            for (int t = 0; t < nTasks; ++t)
+                renderTask(t);
+        }
 
-    // A little optimization - if we have any active voices continue
-    for (const auto &v : voices)
+        for (int t = 0; t < nTasks; ++t)
+        {
+            for (int s = 0; s < vn; ++s)
+            {
+                busL[s] += renderTasks[t].busL[s];
+                busR[s] += renderTasks[t].busR[s];
+            }
+        }
+
+        // The decimator runs even when no voices are playing so its history stays continuous
+        if (oversampling > 1)
+            decimator.process(busL, busR, n);
+
+        if (chans >= 2)
+        {
+            memcpy(out[0] + offset, busL, n * sizeof(float));
+            memcpy(out[1] + offset, busR, n * sizeof(float));
+            for (uint32_t ch = 2; ch < chans; ++ch)
+                memset(out[ch] + offset, 0, n * sizeof(float));
+        }
+        else if (chans == 1)
+        {
+            for (int s = 0; s < n; ++s)
+                out[0][offset + s] = (busL[s] + busR[s]) * 0.5f;
+        }
+
+        offset += n;
+        frames -= n;
+    }
+}
+
+/*
+ * Run the control clock over the next span: up to `frames` output frames, or as many as fit
+ * in renderSpanFrames voice frames. Each chunk stops at a control tick or after blockSize
+ * voice frames, whichever comes first, and carries the smoothed values as of its start and
+ * the groups which moved (by a tick, or by an event before the span) since the last chunk.
+ * Returns the output frames the span covers.
+ */
+int ClapSawDemo::planControlChunks(int frames)
+{
+    auto maxFrames = renderSpanFrames / oversampling;
+    auto n{0};
+    nControlChunks = 0;
+    while (n < frames && n < maxFrames && nControlChunks < maxSpanChunks)
     {
-        if (v.state != SawDemoVoice::OFF)
+        if (controlCountdown == 0)
         {
-            return CLAP_PROCESS_CONTINUE;
+            tickSmoothers();
+            controlCountdown = controlRate;
         }
+
+        auto cn = std::min({frames - n, maxFrames - n, SawDemoVoice::blockSize / oversampling,
+                            controlCountdown});
+        auto &c = controlChunks[nControlChunks++];
+        c.offset = n * oversampling;
+        c.frames = cn * oversampling;
+        c.dirty = smoothingDirty;
+        for (int i = 0; i < nSmoothed; ++i)
+            c.values[i] = smoothers[i].value;
+        smoothingDirty = 0;
+
+        controlCountdown -= cn;
+        n += cn;
     }
+    return n;
+}
 
-    // Otherwise we have no voices - we can return CLAP_PROCESS_SLEEP until we get the next event
-    // And our host can optionally skip processing
-    return CLAP_PROCESS_SLEEP;
+/*
+ * Render one task's voices through every chunk of the span into its own bus. The tasks share
+ * nothing but the (read only) chunks, so they can run at once. A voice which finishes part way
+ * through the span drops out at the next chunk, and we move its endedAt from the chunk to the
+ * output block.
+ */
+void ClapSawDemo::renderTask(int taskIndex)
+{
+    auto &t = renderTasks[taskIndex];
+    const auto &last = controlChunks[nControlChunks - 1];
+    auto vn = last.offset + last.frames;
+    memset(t.busL, 0, vn * sizeof(float));
+    memset(t.busR, 0, vn * sizeof(float));
+
+    for (int k = 0; k < nControlChunks; ++k)
+    {
+        const auto &c = controlChunks[k];
+        SawDemoVoice *playing[voicesPerTask];
+        int np{0};
+        for (int i = 0; i < t.count; ++i)
+        {
+            auto &v = voices.voice(t.voices[i]);
+            if (!v.isPlaying())
+                continue;
+            if (c.dirty)
+                applySmoothedToVoice(t.voices[i], c.dirty, c.values);
+            playing[np++] = &v;
+        }
+
+        for (int q = 0; q < np; q += VoiceQuad::lanes)
+            VoiceQuad::render(playing + q, std::min(VoiceQuad::lanes, np - q), t.busL + c.offset,
+                              t.busR + c.offset, c.frames);
+
+        for (int i = 0; i < np; ++i)
+            if (!playing[i]->isPlaying())
+                playing[i]->endedAt = spanOffset + (c.offset + playing[i]->endedAt) / oversampling;
+    }
 }
 
 /*
@@ -513,6 +731,8 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
     if (evt->space_id != CLAP_CORE_EVENT_SPACE_ID)
         return;
 
+    profiler.countEvent(evt->type);
+
     switch (evt->type)
     {
     case CLAP_EVENT_MIDI:
@@ -544,11 +764,14 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
             // pitch bend
             auto bv = (mevt->data[1] + mevt->data[2] * 128 - 8192) / 8192.0;
 
-            for (auto &v : voices)
-            {
-                v.pitchBendWheel = bv * 2; // just hardcode a pitch bend depth of 2
-                v.recalcPitch();
-            }
+            pitchBendWheel = bv * 2; // just hardcode a pitch bend depth of 2
+            voices.forEachPlaying(
+                [this](int idx)
+                {
+                    auto &c = voices.controls(idx);
+                    c.pitchBendWheel = pitchBendWheel;
+                    voices.voice(idx).recalcPitch(c);
+                });
 
             break;
         }
@@ -557,9 +780,8 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
     }
     /*
      * CLAP_EVENT_NOTE_ON and OFF simply deliver the event to the note creators below,
-     * which find (probably) and activate a spare or playing voice. Our 'voice stealing'
-     * algorithm here is 'just don't play a note 65 if 64 are ringing. Remember this is an
-     * example synth!
+     * which find (probably) and activate a spare or playing voice. If every voice is
+     * busy handleNoteOn steals one according to the steal mode parameter.
      */
     case CLAP_EVENT_NOTE_ON:
     {
@@ -582,20 +804,11 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
     {
         auto v = reinterpret_cast<const clap_event_param_value *>(evt);
 
-        *paramToValue[v->param_id] = v->value;
-        pushParamsToVoices();
+        setParamValue(v->param_id, v->value);
 
-#if HAS_GUI
-        if (editor)
-        {
-            auto r = ToUI();
-            r.type = ToUI::PARAM_VALUE;
-            r.id = v->param_id;
-            r.value = (double)v->value;
-
-            toUiQ.try_enqueue(r);
-        }
-#endif
+        auto idx = paramIndex.indexOf(v->param_id);
+        if (idx >= 0)
+            paramMirror.set(idx, v->value);
     }
     break;
     /*
@@ -608,42 +821,43 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
         auto pevt = reinterpret_cast<const clap_event_param_mod *>(evt);
 
         // This little lambda updates a modulation slot in a voice properly
-        auto applyToVoice = [&pevt](auto &v)
+        auto applyToVoice = [this, &pevt](int idx)
         {
-            if (!v.isPlaying())
-                return;
+            auto &v = voices.voice(idx);
+            auto &c = voices.controls(idx);
 
             auto pd = pevt->param_id;
             switch (pd)
             {
             case paramIds::pmCutoff:
             {
-                v.cutoffMod = pevt->amount;
-                v.recalcFilter();
+                c.cutoffMod = pevt->amount;
+                v.recalcFilter(c);
                 break;
             }
             case paramIds::pmUnisonSpread:
             {
-                v.uniSpreadMod = pevt->amount;
-                v.recalcPitch();
+                c.uniSpreadMod = pevt->amount;
+                v.recalcPitch(c);
                 break;
             }
             case paramIds::pmOscDetune:
             {
                 // _DBGCOUT << "Detune Mod" << _D(pevt->amount) << std::endl;
-                v.oscDetuneMod = pevt->amount;
-                v.recalcPitch();
+                c.oscDetuneMod = pevt->amount;
+                v.recalcPitch(c);
                 break;
             }
             case paramIds::pmResonance:
             {
-                v.resMod = pevt->amount;
-                v.recalcFilter();
+                c.resMod = pevt->amount;
+                v.recalcFilter(c);
                 break;
             }
             case paramIds::pmPreFilterVCA:
             {
-                v.preFilterVCAMod = pevt->amount;
+                c.preFilterVCAMod = pevt->amount;
+                v.recalcLevels(c);
             }
             }
         };
@@ -657,33 +871,17 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
         if (pevt->note_id >= 0)
         {
             // poly by note_id
-            for (auto &v : voices)
-            {
-                if (v.note_id == pevt->note_id)
-                {
-                    applyToVoice(v);
-                }
-            }
+            voices.forEachWithNoteId(pevt->note_id, applyToVoice);
         }
         else if (pevt->key >= 0 && pevt->channel >= 0 && pevt->port_index >= 0)
         {
             // poly by PCK
-            for (auto &v : voices)
-            {
-                if (v.key == pevt->key && v.channel == pevt->channel &&
-                    v.portid == pevt->port_index)
-                {
-                    applyToVoice(v);
-                }
-            }
+            voices.forEachWithPCK(pevt->port_index, pevt->channel, pevt->key, applyToVoice);
         }
         else
         {
             // mono
-            for (auto &v : voices)
-            {
-                applyToVoice(v);
-            }
+            voices.forEachPlaying(applyToVoice);
         }
     }
     break;
@@ -694,27 +892,27 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
     case CLAP_EVENT_NOTE_EXPRESSION:
     {
         auto pevt = reinterpret_cast<const clap_event_note_expression *>(evt);
-        for (auto &v : voices)
-        {
-            if (!v.isPlaying())
-                continue;
 
-            // Note expressions work on key not note id
-            if (v.key == pevt->key && v.channel == pevt->channel && v.portid == pevt->port_index)
+        auto applyToVoice = [this, pevt](int idx)
+        {
+            auto &v = voices.voice(idx);
+            auto &c = voices.controls(idx);
+            switch (pevt->expression_id)
             {
-                switch (pevt->expression_id)
-                {
-                case CLAP_NOTE_EXPRESSION_VOLUME:
-                    // I can mod the VCA
-                    v.volumeNoteExpressionValue = pevt->value - 1.0;
-                    break;
-                case CLAP_NOTE_EXPRESSION_TUNING:
-                    v.pitchNoteExpressionValue = pevt->value;
-                    v.recalcPitch();
-                    break;
-                }
+            case CLAP_NOTE_EXPRESSION_VOLUME:
+                // I can mod the VCA
+                c.volumeNoteExpressionValue = pevt->value - 1.0;
+                v.recalcLevels(c);
+                break;
+            case CLAP_NOTE_EXPRESSION_TUNING:
+                c.pitchNoteExpressionValue = pevt->value;
+                v.recalcPitch(c);
+                break;
             }
-        }
+        };
+
+        // Note expressions work on key not note id
+        voices.forEachWithPCK(pevt->port_index, pevt->channel, pevt->key, applyToVoice);
     }
     break;
     }
@@ -723,67 +921,81 @@ void ClapSawDemo::handleInboundEvent(const clap_event_header_t *evt)
 void ClapSawDemo::handleEventsFromUIQueue(const clap_output_events_t *ov)
 {
 #if HAS_GUI
-    bool uiAdjustedValues{false};
-    ClapSawDemo::FromUI r;
-    while (fromUiQ.try_dequeue(r))
-    {
-        switch (r.type)
-        {
-        case FromUI::BEGIN_EDIT:
-        case FromUI::END_EDIT:
+    auto sendValues = [this, ov]()
+    { fromUi.params.drain([this, ov](int idx, double v) { sendUIValueToHost(idx, v, ov); }); };
+
+    /*
+     * Gestures come through the ring in order and values through the mailbox, which keeps only
+     * the latest. So that the host sees a gesture's final value before the gesture ends we send
+     * whatever values are waiting before each end, and then any left over after the last.
+     */
+    fromUi.messages.drain(
+        [this, ov, &sendValues](uint16_t type, const void *payload, uint16_t size)
         {
+            if ((type != FromUI::BEGIN_EDIT && type != FromUI::END_EDIT) || size != sizeof(clap_id))
+                return;
+            if (type == FromUI::END_EDIT)
+                sendValues();
+
             auto evt = clap_event_param_gesture();
             evt.header.size = sizeof(clap_event_param_gesture);
-            evt.header.type = (r.type == FromUI::BEGIN_EDIT ? CLAP_EVENT_PARAM_GESTURE_BEGIN
-                                                            : CLAP_EVENT_PARAM_GESTURE_END);
+            evt.header.type = (type == FromUI::BEGIN_EDIT ? CLAP_EVENT_PARAM_GESTURE_BEGIN
+                                                          : CLAP_EVENT_PARAM_GESTURE_END);
             evt.header.time = 0;
             evt.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
             evt.header.flags = 0;
-            evt.param_id = r.id;
-            ov->try_push(ov, &evt.header);
-
-            break;
-        }
-        case FromUI::ADJUST_VALUE:
-        {
-            // So set my value
-            *paramToValue[r.id] = r.value;
-
-            // But we also need to generate outbound message to the host
-            auto evt = clap_event_param_value();
-            evt.header.size = sizeof(clap_event_param_value);
-            evt.header.type = (uint16_t)CLAP_EVENT_PARAM_VALUE;
-            evt.header.time = 0; // for now
-            evt.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-            evt.header.flags = 0;
-            evt.param_id = r.id;
-            evt.value = r.value;
-
-            ov->try_push(ov, &(evt.header));
-
-            uiAdjustedValues = true;
-        }
-        }
-    }
+            memcpy(&evt.param_id, payload, sizeof(clap_id));
+            if (!ov->try_push(ov, &evt.header))
+                profiler.count(profiling::ctTryPushFailed);
+        });
+    sendValues();
+#endif
+}
 
-    // Similarly we need to push values to a UI on startup
-    if (refreshUIValues && editor)
-    {
-        _DBGCOUT << "Pushing a refresh of UI values to the editor" << std::endl;
-        refreshUIValues = false;
+void ClapSawDemo::sendUIValueToHost(int index, double value, const clap_output_events_t *ov)
+{
+    // So set my value. The editor already shows it, so don't flag it back to the editor
+    setParamValue(paramDefs[index].id, value);
+    paramMirror.store(index, value);
+
+    // But we also need to generate outbound message to the host
+    auto evt = clap_event_param_value();
+    evt.header.size = sizeof(clap_event_param_value);
+    evt.header.type = (uint16_t)CLAP_EVENT_PARAM_VALUE;
+    evt.header.time = 0; // for now
+    evt.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    evt.header.flags = 0;
+    evt.param_id = paramDefs[index].id;
+    evt.value = value;
+
+    if (!ov->try_push(ov, &(evt.header)))
+        profiler.count(profiling::ctTryPushFailed);
+}
 
-        for (const auto &[k, v] : paramToValue)
-        {
-            auto r = ToUI();
-            r.type = ToUI::PARAM_VALUE;
-            r.id = k;
-            r.value = *v;
-            toUiQ.try_enqueue(r);
-        }
-    }
+/*
+ * Notes for the editor are batched over a block and sent as one message at the end of it. If
+ * a block has more notes than fit in a batch we send a batch early; if the ring is full the
+ * batch is dropped, which only costs the editor some display.
+ */
+void ClapSawDemo::queueNoteForUI(int key, bool on)
+{
+#if HAS_GUI
+    if (!editor)
+        return;
+    if (uiNoteBatchCount == uiNoteBatchSize)
+        sendNotesToUI();
+    uiNoteBatch[uiNoteBatchCount++] = (uint8_t)((key & 0x7F) | (on ? 0x80 : 0));
+#endif
+}
 
-    if (uiAdjustedValues)
-        pushParamsToVoices();
+void ClapSawDemo::sendNotesToUI()
+{
+#if HAS_GUI
+    if (uiNoteBatchCount == 0)
+        return;
+    if (!toUi.push(ToUI::MIDI_NOTES, uiNoteBatch, (uint16_t)uiNoteBatchCount))
+        profiler.count(profiling::ctToUiDropped);
+    uiNoteBatchCount = 0;
 #endif
 }
 
@@ -793,89 +1005,127 @@ void ClapSawDemo::handleEventsFromUIQueue(const clap_output_events_t *ov)
  */
 void ClapSawDemo::handleNoteOn(int port_index, int channel, int key, int noteid)
 {
-    bool foundVoice{false};
-    for (auto &v : voices)
-    {
-        if (v.state == SawDemoVoice::OFF)
-        {
-            activateVoice(v, port_index, channel, key, noteid);
-            foundVoice = true;
-            break;
-        }
-    }
+    auto idx = voices.allocate();
 
-    if (!foundVoice)
+    if (idx < 0)
     {
-        // We could steal oldest. If you want to do that toss in a PR to add age
-        // to the voice I guess. This is just a demo synth though.
-        auto idx = rand() % max_voices;
-        auto &v = voices[idx];
-        terminatedVoices.emplace_back(v.portid, v.channel, v.key, v.note_id);
-        activateVoice(v, port_index, channel, key, noteid);
+        idx = voices.steal((VoiceStealMode) static_cast<int>(param<pmStealMode>()), port_index,
+                           channel, key);
+        profiler.count(profiling::ctVoiceSteal);
+        const auto &c = voices.controls(idx);
+        terminatedVoices.emplace_back(0, c.portid, c.channel, c.key, c.note_id);
     }
+    activateVoice(idx, port_index, channel, key, noteid);
 
 #if HAS_GUI
     dataCopyForUI.updateCount++;
     dataCopyForUI.polyphony++;
 
-    if (editor)
-    {
-        auto r = ToUI();
-        r.type = ToUI::MIDI_NOTE_ON;
-        r.id = (uint32_t)key;
-        toUiQ.try_enqueue(r);
-    }
 #endif
+    queueNoteForUI(key, true);
 }
 
 void ClapSawDemo::handleNoteOff(int port_index, int channel, int n)
 {
-    for (auto &v : voices)
+    voices.forEachWithPCK(port_index, channel, n, [this](int idx) { voices.voice(idx).release(); });
+
+    queueNoteForUI(n, false);
+}
+
+/*
+ * The polyphony and oversampling parameters (and the render mode) only take effect at
+ * activate, so if the engine no longer matches them ask the host to deactivate and reactivate
+ * us. requestRestart is thread safe, and we read the parameters from the mirror, so this is
+ * fine from either the audio thread or the main thread (renderSetMode).
+ */
+void ClapSawDemo::checkActivateParams()
+{
+    if (!isActive())
+        return;
+
+    auto want = std::clamp((int)mirrored<pmPolyphony>(), 1, max_voices);
+    auto offline = (renderMode == CLAP_RENDER_OFFLINE);
+    if (want != voices.getCapacity() || offline != activatedOffline ||
+        wantedOversampling() != oversampling)
+        _host.requestRestart();
+}
+
+// Recompute the tail; process tells the host if it moved
+void ClapSawDemo::updateTail()
+{
+    auto release = std::ceil(scaleTimeParamToSeconds(param<pmAmpRelease>()) * sampleRate);
+    tailFrames = (uint32_t)release + (uint32_t)decimator.latency();
+}
+
+/*
+ * The engine is silent when no voice is in use, none is waiting to report its end, no
+ * smoother is still ramping, and the decimator has nothing left in its filters. Until the
+ * next event every block would then render as exact zeros.
+ */
+bool ClapSawDemo::isSilent() const
+{
+    if (voices.anyInUse() || !terminatedVoices.empty() || !decimator.isFlushed())
+        return false;
+    for (const auto &s : smoothers)
+        if (s.isMoving())
+            return false;
+    return true;
+}
+
+/*
+ * Move the control rate clock on by frames without rendering, exactly as
+ * renderVoicesToOutput would have done over silence, so a block skipped by the fast path
+ * leaves the next notes rendering on the same control ticks.
+ */
+void ClapSawDemo::skipControlFrames(uint32_t frames)
+{
+    if (frames <= (uint32_t)controlCountdown)
     {
-        if (v.isPlaying() && v.key == n && v.portid == port_index && v.channel == channel)
-        {
-            v.release();
-        }
+        controlCountdown -= frames;
     }
-
-#if HAS_GUI
-    if (editor)
+    else
     {
-        auto r = ToUI();
-        r.type = ToUI::MIDI_NOTE_OFF;
-        r.id = (uint32_t)n;
-        toUiQ.try_enqueue(r);
+        auto past = (frames - controlCountdown) % controlRate;
+        controlCountdown = past == 0 ? 0 : controlRate - past;
     }
-#endif
+    pushSmoothedParamsToVoices();
 }
 
-void ClapSawDemo::activateVoice(SawDemoVoice &v, int port_index, int channel, int key, int noteid)
+int ClapSawDemo::wantedOversampling() const
 {
-    v.unison = std::max(1, std::min(7, (int)unisonCount));
-    v.filterMode = (int)static_cast<int>(filterMode);
-    v.note_id = noteid;
-    v.portid = port_index;
-    v.channel = channel;
-
-    v.uniSpread = unisonSpread;
-    v.oscDetune = oscDetune;
-    v.cutoff = cutoff;
-    v.res = resonance;
-    v.preFilterVCA = preFilterVCA;
-    v.ampRelease = scaleTimeParamToSeconds(ampRelease);
-    v.ampAttack = scaleTimeParamToSeconds(ampAttack);
-    v.ampGate = ampIsGate > 0.5;
+    if (renderMode == CLAP_RENDER_OFFLINE)
+        return offlineOversampling;
+    return 1 << std::clamp((int)mirrored<pmOversampling>(), 0, 2);
+}
+
+void ClapSawDemo::activateVoice(int idx, int port_index, int channel, int key, int noteid)
+{
+    voices.assignNote(idx, port_index, channel, key, noteid);
+    auto &c = voices.controls(idx);
+
+    c.unison = std::max(1, std::min(7, (int)param<pmUnisonCount>()));
+    c.filterMode = (int)static_cast<int>(param<pmFilterMode>());
+
+    c.uniSpread = smoothers[smUnisonSpread].value;
+    c.oscDetune = smoothers[smOscDetune].value;
+    c.cutoff = smoothers[smCutoff].value;
+    c.res = smoothers[smResonance].value;
+    c.preFilterVCA = smoothers[smPreFilterVCA].value;
+    c.ampRelease = scaleTimeParamToSeconds(param<pmAmpRelease>());
+    c.ampAttack = scaleTimeParamToSeconds(param<pmAmpAttack>());
+    c.ampGate = param<pmAmpIsGate>() > 0.5;
+    c.pitchBendWheel = pitchBendWheel;
 
     // reset all the modulations
-    v.cutoffMod = 0;
-    v.oscDetuneMod = 0;
-    v.resMod = 0;
-    v.preFilterVCAMod = 0;
-    v.uniSpreadMod = 0;
-    v.volumeNoteExpressionValue = 0;
-    v.pitchNoteExpressionValue = 0;
-
-    v.start(key);
+    c.cutoffMod = 0;
+    c.oscDetuneMod = 0;
+    c.resMod = 0;
+    c.preFilterVCAMod = 0;
+    c.uniSpreadMod = 0;
+    c.volumeNoteExpressionValue = 0;
+    c.pitchNoteExpressionValue = 0;
+
+    voices.voice(idx).start(c);
 }
 
 /*
@@ -885,6 +1135,8 @@ void ClapSawDemo::activateVoice(SawDemoVoice &v, int port_index, int channel, in
  */
 void ClapSawDemo::paramsFlush(const clap_input_events *in, const clap_output_events *out) noexcept
 {
+    adoptStateSnapshot();
+
     auto sz = in->size(in);
 
     // This pointer is the sentinel to our next event which we advance once an event is processed
@@ -895,6 +1147,7 @@ void ClapSawDemo::paramsFlush(const clap_input_events *in, const clap_output_eve
     }
 
     handleEventsFromUIQueue(out);
+    sendNotesToUI();
 
     // We will never generate a note end event with processing active, and we have no midi
     // output, so we are done.
@@ -902,23 +1155,148 @@ void ClapSawDemo::paramsFlush(const clap_input_events *in, const clap_output_eve
 
 void ClapSawDemo::pushParamsToVoices()
 {
-    for (auto &v : voices)
-    {
-        if (v.isPlaying())
+    voices.forEachPlaying(
+        [this](int idx)
         {
-            v.uniSpread = unisonSpread;
-            v.oscDetune = oscDetune;
-            v.cutoff = cutoff;
-            v.res = resonance;
-            v.preFilterVCA = preFilterVCA;
-            v.ampRelease = scaleTimeParamToSeconds(ampRelease);
-            v.ampAttack = scaleTimeParamToSeconds(ampAttack);
-            v.ampGate = ampIsGate > 0.5;
-            v.filterMode = filterMode;
-
-            v.recalcPitch();
-            v.recalcFilter();
-        }
+            auto &c = voices.controls(idx);
+            c.uniSpread = smoothers[smUnisonSpread].value;
+            c.oscDetune = smoothers[smOscDetune].value;
+            c.cutoff = smoothers[smCutoff].value;
+            c.res = smoothers[smResonance].value;
+            c.preFilterVCA = smoothers[smPreFilterVCA].value;
+            c.ampRelease = scaleTimeParamToSeconds(param<pmAmpRelease>());
+            c.ampAttack = scaleTimeParamToSeconds(param<pmAmpAttack>());
+            c.ampGate = param<pmAmpIsGate>() > 0.5;
+            c.filterMode = param<pmFilterMode>();
+
+            auto &v = voices.voice(idx);
+            v.recalcPitch(c);
+            v.recalcFilter(c);
+            v.recalcLevels(c);
+        });
+}
+
+/*
+ * setParamValue is the one place a parameter value changes, whether from the host or
+ * the UI. Smoothed parameters start a ramp towards the new value which the render loop
+ * advances; everything else is pushed to the voices immediately.
+ */
+void ClapSawDemo::setParamValue(clap_id paramId, double value)
+{
+    auto idx = paramIndex.indexOf(paramId);
+    if (idx < 0)
+        return;
+    paramValues[idx] = value;
+
+    auto sm = smoothedParamFor(paramId);
+    if (sm >= 0)
+    {
+        // With nothing sounding there is nothing to zipper, so just jump
+        auto ticks = 0;
+        if (voices.anyInUse())
+            ticks =
+                (int)std::round(param<pmParamSmoothing>() * 0.001 * sampleRate / controlRate);
+        smoothers[sm].setTarget(value, ticks);
+        smoothingDirty |= dirtyGroupFor(sm);
+        return;
+    }
+
+    pushParamsToVoices();
+    if (paramId == pmPolyphony || paramId == pmOversampling)
+        checkActivateParams();
+    if (paramId == pmAmpRelease)
+        updateTail();
+}
+
+int ClapSawDemo::smoothedParamFor(clap_id paramId) const
+{
+    switch (paramId)
+    {
+    case pmCutoff:
+        return smCutoff;
+    case pmResonance:
+        return smResonance;
+    case pmPreFilterVCA:
+        return smPreFilterVCA;
+    case pmOscDetune:
+        return smOscDetune;
+    case pmUnisonSpread:
+        return smUnisonSpread;
+    }
+    return -1;
+}
+
+// Which voice recalc a smoothed parameter feeds
+uint32_t ClapSawDemo::dirtyGroupFor(int smoothedParam)
+{
+    switch (smoothedParam)
+    {
+    case smCutoff:
+    case smResonance:
+        return dirtyFilter;
+    case smPreFilterVCA:
+        return dirtyLevels;
+    }
+    return dirtyPitch;
+}
+
+void ClapSawDemo::snapSmoothers()
+{
+    smoothers[smCutoff].snap(param<pmCutoff>());
+    smoothers[smResonance].snap(param<pmResonance>());
+    smoothers[smPreFilterVCA].snap(param<pmPreFilterVCA>());
+    smoothers[smOscDetune].snap(param<pmOscDetune>());
+    smoothers[smUnisonSpread].snap(param<pmUnisonSpread>());
+    smoothingDirty = dirtyPitch | dirtyFilter | dirtyLevels;
+}
+
+// Advance every moving smoother one control tick and note which recalc groups moved
+void ClapSawDemo::tickSmoothers()
+{
+    for (int i = 0; i < nSmoothed; ++i)
+    {
+        if (!smoothers[i].isMoving())
+            continue;
+        smoothers[i].tick();
+        smoothingDirty |= dirtyGroupFor(i);
+    }
+}
+
+void ClapSawDemo::pushSmoothedParamsToVoices()
+{
+    if (!smoothingDirty)
+        return;
+
+    float values[nSmoothed];
+    for (int i = 0; i < nSmoothed; ++i)
+        values[i] = smoothers[i].value;
+    auto dirty = smoothingDirty;
+    voices.forEachPlaying([this, dirty, &values](int idx)
+                          { applySmoothedToVoice(idx, dirty, values); });
+    smoothingDirty = 0;
+}
+
+// Push the smoothed values in the dirty groups into one voice. Render tasks call this too.
+void ClapSawDemo::applySmoothedToVoice(int idx, uint32_t dirty, const float *values)
+{
+    auto &c = voices.controls(idx);
+    auto &v = voices.voice(idx);
+    if (dirty & dirtyPitch)
+    {
+        c.uniSpread = values[smUnisonSpread];
+        c.oscDetune = values[smOscDetune];
+        v.recalcPitch(c);
+    }
+    if (dirty & dirtyFilter)
+    {
+        c.cutoff = values[smCutoff];
+        c.res = values[smResonance];
+        v.recalcFilter(c);
+    }
+    if (dirty & dirtyLevels)
+    {
+        c.preFilterVCA = values[smPreFilterVCA];
+        v.recalcLevels(c);
     }
 }
 
@@ -943,93 +1321,219 @@ float ClapSawDemo::scaleSecondsToTimeParam(float seconds)
 
 bool ClapSawDemo::stateSave(const clap_ostream *stream) noexcept
 {
-    // Oh this is soooo bad. Please don't judge me. I'm just trying to get this
-    // together for launch day! If you are using this as an example for your plugins,
-    // you should write a less dumb serializer of course. On and I bet this might have
-    // a locale problem?
-    std::ostringstream oss;
-    auto cloc = std::locale("C");
-    oss.imbue(cloc);
-    oss << "STREAM-VERSION-1;";
-    for (const auto &[id, val] : paramToValue)
-    {
-        oss << id << "=" << std::setw(30) << std::setprecision(20) << *val << ";";
-    }
-    _DBGCOUT << oss.str() << std::endl;
-
-    auto st = oss.str();
-    auto c = st.c_str();
-    auto s = st.length() + 1; // write the null terminator
-    while (s > 0)
+    StateWriter writer(stream);
+    writer.bytes(stateMagic, sizeof(stateMagic));
+    writer.u32(stateVersion);
+    writer.u32(nParams);
+    for (int i = 0; i < nParams; ++i)
     {
-        auto r = stream->write(stream, c, s);
-        if (r < 0)
-            return false;
-        s -= r;
-        c += r;
+        writer.u32(paramDefs[i].id);
+        writer.f64(paramMirror.get(i));
     }
-    return true;
+    return writer.finish();
 }
 
 bool ClapSawDemo::stateLoad(const clap_istream *stream) noexcept
 {
-    // Again, see the comment above on 'this is terrible'
-    static constexpr uint32_t maxSize = 4096 * 8, chunkSize = 256;
-    char buffer[maxSize];
-    char *bp = &(buffer[0]);
-    int64_t rd{0};
-    int64_t totalRd{0};
-
-    buffer[0] = 0;
-    while ((rd = stream->read(stream, bp, chunkSize)) > 0)
+    StateReader reader(stream);
+
+    // Parameters the state doesn't mention go back to their defaults
+    double values[nParams];
+    for (int i = 0; i < nParams; ++i)
+        values[i] = paramDefs[i].defaultValue;
+
+    char magic[sizeof(stateMagic)];
+    if (!reader.bytes(magic, sizeof(magic)))
+    {
+        _DBGCOUT << "Invalid stream: too short" << std::endl;
+        return false;
+    }
+
+    if (memcmp(magic, stateMagic, sizeof(magic)) == 0)
     {
-        bp += rd;
-        totalRd += rd;
-        if (totalRd >= maxSize - chunkSize - 1)
+        // Version 2 is the only binary layout there has been; 1 is the text format and
+        // anything else is from a newer synth or isn't a state of ours
+        uint32_t version{0}, count{0};
+        if (!reader.u32(version) || !reader.u32(count) || version != stateVersion)
         {
-            _DBGCOUT << "Invalid stream: Why did you send me so many bytes!" << std::endl;
-            // What the heck? You sdent me more than 32kb of data for a 700 byte string?
-            // That means my next chunk read will blow out memory so....
+            _DBGCOUT << "Invalid stream: bad header or version " << version << std::endl;
             return false;
         }
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t id;
+            double val;
+            if (!reader.u32(id) || !reader.f64(val))
+            {
+                _DBGCOUT << "Invalid stream: truncated at param " << i << std::endl;
+                return false;
+            }
+
+            // An id we don't know is from some other version of the synth; skip it
+            auto idx = paramIndex.indexOf(id);
+            if (idx >= 0)
+                values[idx] = val;
+        }
+    }
+    else if (!loadTextState(reader, magic, values))
+    {
+        _DBGCOUT << "Invalid stream" << std::endl;
+        return false;
     }
 
-    // Make sure I'm null terminated in case you hand me total garbage
-    if (totalRd < maxSize)
-        buffer[totalRd] = 0;
+    publishLoadedValues(values);
+    return true;
+}
 
-    auto dat = std::string(buffer);
-    _DBGCOUT << dat << std::endl;
+/*
+ * Both stateLoad and presetLoadFromLocation end up here with a full set of values in
+ * paramDefs order, which we tidy up and hand to the engine.
+ */
+void ClapSawDemo::publishLoadedValues(const double *values)
+{
+    auto *snapshot = stateSnapshots.writeBuffer();
+    for (int i = 0; i < nParams; ++i)
+    {
+        auto v = std::isfinite(values[i]) ? values[i] : paramDefs[i].defaultValue;
+        snapshot[i] = std::clamp(v, paramDefs[i].minValue, paramDefs[i].maxValue);
+    }
 
-    std::vector<std::string> items;
-    size_t spos{0};
-    while ((spos = dat.find(';')) != std::string::npos)
+    /*
+     * The main thread sees the new values straight away, so a get_value or a save right after
+     * the load agrees with it even before the audio thread has caught up, and the editor is
+     * told about them now too.
+     */
+    for (int i = 0; i < nParams; ++i)
+        paramMirror.set(i, snapshot[i]);
+    stateSnapshots.publish();
+
+    /*
+     * The engine belongs to the audio thread while we are active, so it picks the snapshot
+     * up at its next process or paramsFlush, and we ask for a flush in case the host isn't
+     * processing. Otherwise no audio thread is running and we can adopt it here.
+     */
+    if (isActive())
     {
-        auto l = dat.substr(0, spos);
-        dat = dat.substr(spos + 1);
-        items.push_back(l);
+        if (_host.canUseParams())
+            _host.paramsRequestFlush();
     }
+    else
+    {
+        adoptStateSnapshot();
+    }
+
+    // Every value may have changed under the host, so have it read them again
+    if (_host.canUseParams())
+        _host.paramsRescan(CLAP_PARAM_RESCAN_VALUES);
+}
 
-    if (items[0] != "STREAM-VERSION-1")
+bool ClapSawDemo::presetLoadFromLocation(uint32_t locationKind, const char *location,
+                                         const char *loadKey) noexcept
+{
+    auto failed = [&](int32_t osError, const char *msg)
     {
-        _DBGCOUT << "Invalid stream" << std::endl;
+        _DBGCOUT << "Preset load failed: " << msg << std::endl;
+        if (_host.canUsePresetLoad())
+            _host.presetLoadOnError(locationKind, location, loadKey, osError, msg);
         return false;
+    };
+
+    // All our presets live in bank files
+    if (locationKind != CLAP_PRESET_DISCOVERY_LOCATION_FILE || !location)
+        return failed(0, "ClapSawDemo presets are only loaded from bank files");
+
+    PresetBank bank;
+    if (!bank.open(location))
+        return failed(bank.osError(), bank.errorMessage());
+
+    char *end{nullptr};
+    auto preset = loadKey ? std::strtoul(loadKey, &end, 10) : 0;
+    if ((loadKey && (end == loadKey || *end != 0)) || preset >= bank.presetCount())
+        return failed(0, "No such preset in the bank");
+
+    double values[nParams];
+    for (int i = 0; i < nParams; ++i)
+        values[i] = paramDefs[i].defaultValue;
+    for (uint32_t p = 0; p < bank.paramCount(); ++p)
+    {
+        auto idx = paramIndex.indexOf(bank.paramId(p));
+        if (idx >= 0)
+            values[idx] = bank.value((uint32_t)preset, p);
     }
-    for (auto i : items)
+    publishLoadedValues(values);
+
+    if (_host.canUsePresetLoad())
+        _host.presetLoadLoaded(locationKind, location, loadKey);
+    return true;
+}
+
+void ClapSawDemo::adoptStateSnapshot()
+{
+    auto *snapshot = stateSnapshots.adopt();
+    if (!snapshot)
+        return;
+
+    std::copy(snapshot, snapshot + nParams, paramValues);
+    for (int i = 0; i < nParams; ++i)
+        paramMirror.set(i, paramValues[i]);
+
+    // A new state is a new patch, not automation, so don't ramp into it
+    snapSmoothers();
+    pushParamsToVoices();
+    checkActivateParams();
+    updateTail();
+}
+
+/*
+ * The version 1 state was a null terminated C locale string of
+ * "STREAM-VERSION-1;id=value;id=value;...". start is the four bytes stateLoad has already
+ * read looking for the binary magic. We read the rest an item at a time into a small buffer;
+ * no item it ever wrote is longer than 40 characters.
+ */
+bool ClapSawDemo::loadTextState(StateReader &reader, const char *start, double *values)
+{
+    static constexpr char header[] = "STREAM-VERSION-1;";
+    static constexpr size_t headerSize = sizeof(header) - 1;
+    char head[headerSize];
+    memcpy(head, start, sizeof(stateMagic));
+    if (!reader.bytes(head + sizeof(stateMagic), headerSize - sizeof(stateMagic)) ||
+        memcmp(head, header, headerSize) != 0)
+        return false;
+
+    std::istringstream istr;
+    istr.imbue(std::locale("C"));
+
+    char item[128];
+    size_t len{0};
+    auto more = true;
+    while (more)
     {
-        auto epos = i.find('=');
-        if (epos == std::string::npos)
+        char c{0};
+        more = reader.byte(c) && c != '\0';
+        if (more && c != ';')
+        {
+            if (len == sizeof(item) - 1)
+                return false;
+            item[len++] = c;
+            continue;
+        }
+
+        item[len] = 0;
+        len = 0;
+        auto eq = strchr(item, '=');
+        if (!eq)
             continue; // oh well
-        auto id = std::atoi(i.substr(0, epos).c_str());
-        double val = 0.0;
-        std::istringstream istr(i.substr(epos + 1));
-        istr.imbue(std::locale("C"));
-        istr >> val;
+        *eq = 0;
+        auto idx = paramIndex.indexOf((clap_id)std::strtoul(item, nullptr, 10));
+        if (idx < 0)
+            continue;
 
-        *(paramToValue[(paramIds)id]) = val;
+        double val = 0.0;
+        istr.clear();
+        istr.str(eq + 1);
+        if (istr >> val)
+            values[idx] = val;
     }
-
-    pushParamsToVoices();
     return true;
 }
 
@@ -21,27 +21,37 @@
  * - Hold the CLAP description static object
  * - Advertise parameters and ports
  * - Provide an event handler which responds to events and returns sound
- * - Do voice management. Which is really not very sophisticated (it's just an array of 64
- *   voice objects and we choose the next free one, and if you ask for a 65th voice, nothing
- *   happens).
+ * - Do voice management, through a VoicePool (voice-pool.h). The polyphony parameter sets how
+ *   many voices it holds, up to 256, and when a note arrives with every voice in use we steal
+ *   one according to the steal mode parameter (a VoiceStealMode: the oldest, the quietest, a
+ *   releasing voice first, or one on the same key).
  * - Provide the API points to delegate UI creation to a separate editor object,
  *   coded in clap-saw-demo-editor
  *
  * This demo is coded to be relatively familiar and close to programming styles form other
  * formats where the editor and synth collaborate closely; as described in clap-saw-demo-editor
- * this object also holds the two queues the editor and synth use to communicate; and holds the
+ * this object also holds the two channels the editor and synth use to communicate; and holds the
  * bundle of atomic values to which the editor holds a const &.
  */
 
 #include <clap/helpers/plugin.hh>
 #include <atomic>
 #include <array>
-#include <unordered_map>
 #include <memory>
-#include <readerwriterqueue.h>
 
 #include "saw-voice.h"
-#include <memory>
+#include "voice-quad.h"
+#include "voice-pool.h"
+#include "param-smoother.h"
+#include "param-registry.h"
+#include "state-stream.h"
+#include "param-snapshot.h"
+#include "ui-channel.h"
+#include "preset-bank.h"
+#include "profiling.h"
+#include "render-pool.h"
+#include "oversampler.h"
+#include "denormals.h"
 
 namespace sst::clap_saw_demo
 {
@@ -51,7 +61,9 @@ struct ClapSawDemoEditor;
 struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHandler::Terminate,
                                                   clap::helpers::CheckingLevel::Maximal>
 {
-    static constexpr int max_voices = 64;
+    // The voice pool is allocated for max_voices; the polyphony parameter picks how many of
+    // those we use at activate
+    static constexpr int max_voices = 256;
     ClapSawDemo(const clap_host *host);
     ~ClapSawDemo();
 
@@ -64,15 +76,13 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
     /*
      * Activate makes sure sampleRate is distributed through
      * the data structures, in this case by stamping the sampleRate
-     * onto each pre-allocated voice object.
+     * onto each pre-allocated voice object. It is also where the polyphony
+     * parameter takes effect, since the host expects the voice capacity to
+     * only change across a restart.
      */
     bool activate(double sampleRate, uint32_t minFrameCount,
-                  uint32_t maxFrameCount) noexcept override
-    {
-        for (auto &v : voices)
-            v.sampleRate = sampleRate;
-        return true;
-    }
+                  uint32_t maxFrameCount) noexcept override;
+    void deactivate() noexcept override;
 
     /*
      * Parameter Handling:
@@ -84,9 +94,9 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
      *
      * The implementation of paramsInfo contains the setup of these params.
      *
-     * The actual synth has a very simple model to update parameter values. It
-     * contains a map from these IDs to a double * which the constructor sets up
-     * as references to members.
+     * Everything else about a parameter (range, default, flags, display) is in paramDefs,
+     * the constexpr table below, and the engine keeps the values in a flat array in the same
+     * order. paramIndex maps an id to its place in both; see param-registry.h.
      */
     enum paramIds : uint32_t
     {
@@ -102,20 +112,78 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
 
         pmCutoff = 17,
         pmResonance = 94,
-        pmFilterMode = 14255
+        pmFilterMode = 14255,
+
+        pmPolyphony = 3761,
+        pmStealMode = 5120,
+
+        pmParamSmoothing = 6197,
+
+        pmOversampling = 3094
     };
-    static constexpr int nParams = 10;
+    static constexpr int nParams = 14;
+
+    /*
+     * These constants activate polyphonic modulatability on a parameter. Not all the params
+     * here support that. Polyphony and oversampling only change at activate (changing them
+     * asks the host for a restart) so they aren't automatable, and oversampling only applies
+     * in realtime; offline bounces always run at 4x.
+     */
+    static constexpr uint32_t pfAuto = CLAP_PARAM_IS_AUTOMATABLE;
+    static constexpr uint32_t pfMod = CLAP_PARAM_IS_AUTOMATABLE | CLAP_PARAM_IS_MODULATABLE |
+                                      CLAP_PARAM_IS_MODULATABLE_PER_NOTE_ID |
+                                      CLAP_PARAM_IS_MODULATABLE_PER_KEY;
+    static constexpr uint32_t pfStep = CLAP_PARAM_IS_AUTOMATABLE | CLAP_PARAM_IS_STEPPED;
+
+    // clang-format off
+    static constexpr ParamDef paramDefs[nParams] = {
+        {pmUnisonCount, "Unison Count", "Oscillator",
+            1, SawDemoVoice::max_uni, 3, pfStep, ParamFormat::Voices},
+        {pmUnisonSpread, "Unison Spread in Cents", "Oscillator",
+            0, 100, 10, pfMod, ParamFormat::Cents},
+        {pmOscDetune, "Oscillator Detuning (in cents)", "Oscillator",
+            -200, 200, 0, pfMod, ParamFormat::Cents},
+        {pmAmpAttack, "Amplitude Attack (s)", "Amplitude Envelope Generator",
+            0, 1, 0.01, pfAuto, ParamFormat::Seconds},
+        {pmAmpRelease, "Amplitude Release (s)", "Amplitude Envelope Generator",
+            0, 1, 0.2, pfAuto, ParamFormat::Seconds},
+        {pmAmpIsGate, "Deactivate Amp Envelope", "Amplitude Envelope Generator",
+            0, 1, 0, pfStep, ParamFormat::Gate},
+        {pmPreFilterVCA, "Pre Filter VCA", "Filter",
+            0, 1, 1, pfMod, ParamFormat::Plain},
+        {pmCutoff, "Cutoff in Keys", "Filter",
+            1, 127, 69, pfMod, ParamFormat::Keys},
+        {pmResonance, "Resonance", "Filter",
+            0, 1, 0.7, pfMod, ParamFormat::Plain},
+        {pmFilterMode, "Filter Type", "Filter",
+            SawDemoVoice::StereoSimperSVF::LP, SawDemoVoice::StereoSimperSVF::ALL, 0,
+            pfStep, ParamFormat::FilterMode},
+        {pmPolyphony, "Polyphony", "Voices",
+            1, max_voices, 64, CLAP_PARAM_IS_STEPPED, ParamFormat::Voices},
+        {pmStealMode, "Voice Stealing", "Voices",
+            STEAL_OLDEST, STEAL_SAME_KEY, STEAL_RELEASING_FIRST, pfStep, ParamFormat::StealMode},
+        {pmParamSmoothing, "Parameter Smoothing (ms)", "Voices",
+            0, 200, 10, pfAuto, ParamFormat::Milliseconds},
+        {pmOversampling, "Oversampling", "Voices",
+            0, 2, 0, CLAP_PARAM_IS_STEPPED, ParamFormat::Oversampling}
+    };
+    // clang-format on
+    static constexpr ParamIndex<nParams> paramIndex{paramDefs};
+    static_assert(paramIndex.idsAreUnique(), "Two parameters share an id");
 
     bool implementsParams() const noexcept override { return true; }
     bool isValidParamId(clap_id paramId) const noexcept override
     {
-        return paramToValue.find(paramId) != paramToValue.end();
+        return paramIndex.indexOf(paramId) >= 0;
     }
     uint32_t paramsCount() const noexcept override { return nParams; }
     bool paramsInfo(uint32_t paramIndex, clap_param_info *info) const noexcept override;
     bool paramsValue(clap_id paramId, double *value) noexcept override
     {
-        *value = *paramToValue[paramId];
+        auto idx = paramIndex.indexOf(paramId);
+        if (idx < 0)
+            return false;
+        *value = paramMirror.get(idx);
         return true;
     }
 
@@ -163,20 +231,40 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
     bool implementsVoiceInfo() const noexcept override { return true; }
     bool voiceInfoGet(clap_voice_info *info) noexcept override
     {
-        info->voice_capacity = max_voices;
-        info->voice_count = max_voices;
+        info->voice_capacity = voices.getCapacity();
+        info->voice_count = voices.getCapacity();
         info->flags = CLAP_VOICE_INFO_SUPPORTS_OVERLAPPING_NOTES;
         return true;
     }
 
     /*
-     * I have an unacceptably crude state dump and restore. If you want to
-     * improve it, PRs welcome! But it's just like any other read-and-write-goop
-     * from-a-stream api really.
+     * The state is binary: a magic number, a format version, a count, and then an id and
+     * a value for each parameter, streamed through state-stream.h. Loading reads into a
+     * copy of the values and only applies it once the whole stream has parsed, skipping
+     * ids we don't know. The first releases saved a "STREAM-VERSION-1;id=value;..." text
+     * string, which stateLoad still reads so old projects open.
+     *
+     * stateLoad is on the main thread, and while we are active the audio thread owns the
+     * parameter values, so a loaded state goes across as a snapshot (param-snapshot.h)
+     * which the audio thread adopts in adoptStateSnapshot at the start of its next block.
      */
     bool implementsState() const noexcept override { return true; }
     bool stateSave(const clap_ostream *) noexcept override;
     bool stateLoad(const clap_istream *) noexcept override;
+    static constexpr char stateMagic[4] = {'C', 'S', 'D', 'S'};
+    static constexpr uint32_t stateVersion = 2; // version 1 is the text format
+    static bool loadTextState(StateReader &reader, const char *start, double *values);
+    void publishLoadedValues(const double *values);
+
+    /*
+     * Preset load lets the host (usually its preset browser, which finds our banks through
+     * the preset discovery factory in clap-saw-demo-pluginentry.cpp) load a preset out of a
+     * bank. The location is the bank's path and the load key the preset's number in it; see
+     * preset-bank.h. The values then reach the engine exactly as a loaded state does.
+     */
+    bool implementsPresetLoad() const noexcept override { return true; }
+    bool presetLoadFromLocation(uint32_t locationKind, const char *location,
+                                const char *loadKey) noexcept override;
 
     /*
      * process is the meat of the operation. It does obvious things like trigger
@@ -186,11 +274,24 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
      */
     clap_process_status process(const clap_process *process) noexcept override;
     void handleInboundEvent(const clap_event_header_t *evt);
+    void renderVoicesToOutput(float **out, uint32_t chans, uint32_t offset, int frames);
+    int planControlChunks(int frames);
+    void renderTask(int taskIndex);
+    void reportTerminatedVoices(const clap_output_events *ov, uint32_t eventTime);
     void pushParamsToVoices();
+    void setParamValue(clap_id paramId, double value);
     void handleNoteOn(int port_index, int channel, int key, int noteid);
     void handleNoteOff(int port_index, int channel, int key);
-    void activateVoice(SawDemoVoice &v, int port_index, int channel, int key, int noteid);
+    void activateVoice(int idx, int port_index, int channel, int key, int noteid);
+    void checkActivateParams();
+    void updateTail();
+    bool isSilent() const;
+    void skipControlFrames(uint32_t frames);
     void handleEventsFromUIQueue(const clap_output_events_t *);
+    void sendUIValueToHost(int index, double value, const clap_output_events_t *);
+    void queueNoteForUI(int key, bool on);
+    void sendNotesToUI();
+    void adoptStateSnapshot();
 
     /*
      * In addition to ::process, the plugin should implement ::paramsFlush. ::paramsFlush will be
@@ -200,6 +301,49 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
      */
     void paramsFlush(const clap_input_events *in, const clap_output_events *out) noexcept override;
 
+    /*
+     * With a lot of voices the render is split into tasks of a few voice quads each, which
+     * the host can run in parallel through its thread pool. threadPoolExec is called by the
+     * host's workers from inside our call to threadPoolRequestExec in process, so it is on
+     * the audio thread as far as the rest of the synth is concerned. If the host has no pool
+     * we just run the tasks one after the other ourselves.
+     */
+    bool implementsThreadPool() const noexcept override { return true; }
+    void threadPoolExec(uint32_t taskIndex) noexcept override
+    {
+        ScopedDenormalFlush denormalFlush;
+        renderTask((int)taskIndex);
+    }
+
+    /*
+     * The render extension tells us when the host is bouncing offline rather than playing
+     * in realtime. Offline, and only offline, we activate into the high quality engine:
+     *
+     * - the voices run at offlineOversampling times the host rate and the Decimator
+     *   (oversampler.h) brings the result back down
+     * - the voices use the exact math functions rather than the fast_math approximations
+     * - we hold the process' shared RenderPool (render-pool.h) so hosts without a thread
+     *   pool still get the voices rendered in parallel
+     *
+     * All of that is set up at activate, so a switch of mode while active asks the host
+     * for a restart. Realtime playback stays on the lean path.
+     */
+    bool implementsRender() const noexcept override { return true; }
+    bool renderHasHardRealtimeRequirement() noexcept override { return false; }
+    bool renderSetMode(clap_plugin_render_mode mode) noexcept override;
+
+    // The decimator's filters delay the oversampled output, which we report as latency
+    bool implementsLatency() const noexcept override { return true; }
+    uint32_t latencyGet() const noexcept override { return (uint32_t)decimator.latency(); }
+
+    /*
+     * The tail is how long we can keep sounding after the last note off: the amp release
+     * time plus the decimator's delay. When the release parameter changes process tells the
+     * host at the start of the next block.
+     */
+    bool implementsTail() const noexcept override { return true; }
+    uint32_t tailGet() const noexcept override { return tailFrames; }
+
     /*
      * start and stop processing are called when you start and stop obviously.
      * We update an atomic bool so our UI can go ahead and draw processing state
@@ -232,17 +376,22 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
      *
      * But that UI runs in another thread, and all the CLAP events are handled
      * in process, so we also need to think about inter-thread communication.
-     * To do that we have three core data structures, a function, and one pointer
+     * To do that we have four core data structures, a function, and one pointer
      *
      * - A pointer to an editor object (here a concrete editor, but a more advanced
      *   implementation could make that a proxy or a bool), which we test for null
      *   when the editor is open
-     * - A lock-free queue from the engine to the UI for things like parameter
-     *   updates. This queue is written in `ClapSawDemo::process` if editor is
-     *   non-null and is read in the `::idle` loop of the editor on the UI thread
-     * - A lock-free queue from the UI to the engine for things like begin and end
-     *   gestures and value changes. This is written on the UI thread and read in
-     *   stage 1 of `CLapSawDemo::process` go update engine parameters and send parameter
+     * - A mirror of the engine's parameter values (paramMirror, a ParamMailbox from
+     *   ui-channel.h): an atomic value and a dirty bit per parameter. `ClapSawDemo::process`
+     *   writes it whenever a parameter changes and the `::idle` loop of the editor sweeps
+     *   the dirty bits on the UI thread. However hard the host automates us the editor
+     *   just picks up the latest value of each changed parameter once per idle, and
+     *   nothing can overflow.
+     * - A lock-free ring from the engine to the UI for notes. This is written in
+     *   `ClapSawDemo::process` if editor is non-null and is read in the same `::idle`.
+     * - A lock-free channel from the UI to the engine for begin and end gestures and
+     *   value changes. This is written on the UI thread and read in stage 1 of
+     *   `CLapSawDemo::process` go update engine parameters and send parameter
      *   change events to the host from the processing thread.
      * - A data structure which contains std::atomic values and where the editor keeps
      *   an in-memory const& to it. ::process updates a counter and the idle loop looks
@@ -267,10 +416,6 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
     bool guiAdjustSize(uint32_t *width, uint32_t *height) noexcept override;
     bool guiSetSize(uint32_t width, uint32_t height) noexcept override;
     bool guiGetSize(uint32_t *width, uint32_t *height) noexcept override;
-
-    // Setting this atomic to true will force a push of all current engine
-    // params to ui using the queue mechanism
-    std::atomic<bool> refreshUIValues{false};
 #endif
 
     // This is an API point the editor can call back to request the host to flush
@@ -306,6 +451,8 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
 #endif
 
   public:
+    typedef ParamMailbox<nParams> ParamMirror_t;
+
 #if HAS_GUI
     static constexpr uint32_t GUI_DEFAULT_W = 390, GUI_DEFAULT_H = 530;
 
@@ -315,27 +462,21 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
      */
     struct ToUI
     {
-        enum MType
+        enum MType : uint16_t
         {
-            PARAM_VALUE = 0x31,
-            MIDI_NOTE_ON,
-            MIDI_NOTE_OFF
-        } type;
-
-        uint32_t id;  // param-id for PARAM_VALUE, key for noteon/noteoff
-        double value; // value or unused
+            // A block's notes, one byte each: the key, with the top bit set for a note on
+            MIDI_NOTES = 0x31
+        };
     };
 
     struct FromUI
     {
-        enum MType
+        enum MType : uint16_t
         {
+            // The payload is the clap_id of the parameter
             BEGIN_EDIT = 0xF9,
-            END_EDIT,
-            ADJUST_VALUE
-        } type;
-        uint32_t id;
-        double value;
+            END_EDIT
+        };
     };
 
     /*
@@ -352,26 +493,153 @@ struct ClapSawDemo : public clap::helpers::Plugin<clap::helpers::MisbehaviourHan
         std::atomic<double> songpos{0};
     } dataCopyForUI;
 
-    typedef moodycamel::ReaderWriterQueue<ToUI, 4096> SynthToUI_Queue_t;
-    typedef moodycamel::ReaderWriterQueue<FromUI, 4096> UIToSynth_Queue_t;
+    // Parameter values from the editor go through fromUi.params, by paramDefs index
+    typedef MessageRing<4096> SynthToUI_Ring_t;
+    typedef UIChannel<nParams, 4096> UIToSynth_Channel_t;
 
-    SynthToUI_Queue_t toUiQ;
-    UIToSynth_Queue_t fromUiQ;
+    SynthToUI_Ring_t toUi;
+    UIToSynth_Channel_t fromUi;
 
   private:
     ClapSawDemoEditor *editor{nullptr};
+
+    // Notes collect here over a block and go to the editor as one message
+    static constexpr int uiNoteBatchSize = 256;
+    uint8_t uiNoteBatch[uiNoteBatchSize];
+    int uiNoteBatchCount{0};
 #endif
 
     // These items are ONLY read and written on the audio thread, so they
-    // are safe to be non-atomic doubles. We keep a map to locate them
-    // for parameter updates.
-    double unisonCount{3}, unisonSpread{10}, oscDetune{0}, cutoff{69}, resonance{0.7},
-        ampAttack{0.01}, ampRelease{0.2}, ampIsGate{0}, preFilterVCA{1.0}, filterMode{0};
-    std::unordered_map<clap_id, double *> paramToValue;
-
-    // "Voice Management" is "randomly pick a voice to kill and put it in stolen voices"
-    std::array<SawDemoVoice, max_voices> voices;
-    std::vector<std::tuple<int, int, int, int>> terminatedVoices; // that's PCK ID
+    // are safe to be non-atomic doubles. They are in paramDefs order, and the
+    // engine reads the ones it knows by name with param<pmWhatever>(), which
+    // finds the index at compile time.
+    double paramValues[nParams];
+    template <paramIds id> double param() const
+    {
+        constexpr auto idx = paramIndex.indexOf(id);
+        static_assert(idx >= 0, "Not a parameter in paramDefs");
+        return paramValues[idx];
+    }
+
+    /*
+     * paramMirror follows paramValues for everyone else. The audio thread writes it whenever
+     * a parameter changes, flagging the change for the editor unless the editor made it, and
+     * the main thread reads values from it rather than from paramValues.
+     */
+    ParamMirror_t paramMirror;
+    template <paramIds id> double mirrored() const
+    {
+        constexpr auto idx = paramIndex.indexOf(id);
+        static_assert(idx >= 0, "Not a parameter in paramDefs");
+        return paramMirror.get(idx);
+    }
+
+    // stateLoad publishes here and adoptStateSnapshot copies into paramValues
+    ParamSnapshotBuffer<nParams> stateSnapshots;
+
+    /*
+     * The continuous voice parameters are smoothed (see param-smoother.h). The doubles above
+     * are the targets the host and UI see; the voices get the smoothed values, refreshed
+     * every controlRate samples, and only the recalc groups whose values moved are rerun.
+     */
+    static constexpr int controlRate = 32;
+    enum SmoothedParam
+    {
+        smCutoff,
+        smResonance,
+        smPreFilterVCA,
+        smOscDetune,
+        smUnisonSpread,
+        nSmoothed
+    };
+    enum SmoothingDirty : uint32_t
+    {
+        dirtyPitch = 1 << 0,
+        dirtyFilter = 1 << 1,
+        dirtyLevels = 1 << 2
+    };
+    ParamSmoother smoothers[nSmoothed];
+    uint32_t smoothingDirty{0};
+    int controlCountdown{0};
+    double sampleRate{48000};
+
+    int smoothedParamFor(clap_id paramId) const;
+    static uint32_t dirtyGroupFor(int smoothedParam);
+    void snapSmoothers();
+    void tickSmoothers();
+    void pushSmoothedParamsToVoices();
+    void applySmoothedToVoice(int idx, uint32_t dirty, const float *values);
+
+    std::atomic<uint32_t> tailFrames{0};
+    uint32_t reportedTailFrames{0}; // audio thread
+
+    // The bend wheel is channel wide, so we keep it here and stamp it on voices as they start
+    float pitchBendWheel{0.f};
+
+    // Voice management is in voice-pool.h. When the pool is full, handleNoteOn steals
+    // a voice according to stealMode and puts it in terminated voices.
+    VoicePool<max_voices> voices;
+    std::vector<std::tuple<uint32_t, int, int, int, int>> terminatedVoices; // time then PCK ID
+
+    /*
+     * renderVoicesToOutput works in spans of up to renderSpanFrames voice frames. Before
+     * rendering a span it runs the control clock across all of it, recording a ControlChunk
+     * for each stretch between control ticks with the smoothed values in force and which
+     * recalc groups they need. The tasks then take their voices through every chunk of the
+     * span on their own, so a span costs one dispatch to the thread pool however many control
+     * ticks it crosses.
+     */
+    static constexpr int renderSpanFrames = 1024;
+    static constexpr int maxSpanChunks = 2 * renderSpanFrames / controlRate + 2;
+    static_assert(renderSpanFrames <= HalfBandDecimator::maxInput,
+                  "The decimator takes a whole span at once");
+    struct ControlChunk
+    {
+        int offset, frames; // voice frames, from the start of the span
+        uint32_t dirty;     // the SmoothingDirty groups to push before rendering it
+        float values[nSmoothed];
+    };
+    ControlChunk controlChunks[maxSpanChunks];
+    int nControlChunks{0};
+    uint32_t spanOffset{0}; // where the span starts in the output block
+
+    /*
+     * Each render task owns quadsPerTask quads of voices and a bus they sum into, and
+     * renderVoicesToOutput adds the task buses together in order. The split only depends on
+     * how many voices are playing, never on whether a thread pool ran the tasks, so the
+     * output is the same with or without one. Below minTasksForPool the dispatch costs
+     * more than it saves and we render on the audio thread.
+     */
+    static constexpr int quadsPerTask = 2;
+    static constexpr int voicesPerTask = quadsPerTask * VoiceQuad::lanes;
+    static constexpr int maxRenderTasks = max_voices / voicesPerTask;
+    static constexpr int minTasksForPool = 4;
+    struct RenderTask
+    {
+        int voices[voicesPerTask]; // indices into the voice pool
+        int count{0};
+        alignas(16) float busL[renderSpanFrames], busR[renderSpanFrames];
+    };
+    RenderTask renderTasks[maxRenderTasks];
+
+    std::atomic<clap_plugin_render_mode> renderMode{CLAP_RENDER_REALTIME};
+    bool activatedOffline{false}; // the render mode as of the last activate
+    std::shared_ptr<RenderPool> renderPool; // only while activated offline
+
+    /*
+     * The voices render at oversampling times sampleRate. In realtime that is what the
+     * oversampling parameter asks for (oversamplingMode 0, 1 or 2 for 1x, 2x or 4x), and
+     * offline it is always the most we do.
+     */
+    static constexpr int offlineOversampling = 4;
+    int oversampling{1};
+    int wantedOversampling() const;
+    Decimator decimator;
+
+  public:
+    // Audio thread timers and counters, readable from the main thread. See profiling.h; this
+    // compiles away unless the build sets CSD_ENABLE_PROFILING.
+    profiling::Profiler profiler;
 };
 } // namespace sst::clap_saw_demo
 
@@ -0,0 +1,68 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_DENORMALS_H
+#define CLAP_SAW_DEMO_DENORMALS_H
+
+/*
+ * As a voice's release decays the filter integrators decay with it, and once they get below
+ * about 1e-38 they become denormal floats, which many CPUs handle tens of times slower than
+ * normal ones. Rather than test for them in the inner loops we have the CPU flush them to
+ * zero: on x86 by setting the flush-to-zero and denormals-are-zero bits of the MXCSR, and on
+ * arm64 the flush-to-zero bit of the FPCR.
+ *
+ * The floating point mode belongs to the thread, and the host's thread may be running other
+ * plugins which want it left alone, so ScopedDenormalFlush sets it for its own lifetime and
+ * puts back whatever was there before. Anywhere the synth renders on a thread it doesn't own
+ * (process, and the host thread pool's calls to threadPoolExec) holds one, and our own
+ * RenderPool workers hold one for their whole life. On other platforms (emscripten, 32 bit
+ * arm) it does nothing.
+ */
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CSD_DENORMALS_SSE 1
+#include <xmmintrin.h>
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define CSD_DENORMALS_ARM64 1
+#endif
+
+namespace sst::clap_saw_demo
+{
+struct ScopedDenormalFlush
+{
+#if CSD_DENORMALS_SSE
+    static constexpr uint32_t ftzDaz = 0x8040; // FTZ is bit 15, DAZ bit 6
+
+    ScopedDenormalFlush() : prior(_mm_getcsr()) { _mm_setcsr(prior | ftzDaz); }
+    ~ScopedDenormalFlush() { _mm_setcsr(prior); }
+
+    uint32_t prior;
+#elif CSD_DENORMALS_ARM64
+    static constexpr uint64_t fz = 1ULL << 24;
+
+    ScopedDenormalFlush()
+    {
+        asm volatile("mrs %0, fpcr" : "=r"(prior));
+        asm volatile("msr fpcr, %0" : : "r"(prior | fz));
+    }
+    ~ScopedDenormalFlush() { asm volatile("msr fpcr, %0" : : "r"(prior)); }
+
+    uint64_t prior;
+#else
+    ScopedDenormalFlush() {}
+#endif
+
+    ScopedDenormalFlush(const ScopedDenormalFlush &) = delete;
+    ScopedDenormalFlush &operator=(const ScopedDenormalFlush &) = delete;
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_DENORMALS_H
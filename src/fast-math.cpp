@@ -0,0 +1,158 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#include "fast-math.h"
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace sst::clap_saw_demo::fast_math
+{
+namespace
+{
+static constexpr double pival = 3.14159265358979323846;
+static constexpr double ln2 = 0.69314718055994530942;
+
+static constexpr int exp2Steps = 64;
+static constexpr int noteMin = -128, noteMax = 255;
+static constexpr int tanSteps = 512;
+static constexpr double tanMaxW = 0.45;
+
+/*
+ * The tables are filled once when the library loads. The tan table stores tan(pi w) and
+ * its derivative pi (1 + tan^2) at each knot for the Hermite interpolation.
+ */
+struct Tables
+{
+    double exp2Frac[exp2Steps + 1];
+    double noteFreq[noteMax - noteMin + 1];
+    double tanValue[tanSteps + 1], tanSlope[tanSteps + 1];
+
+    Tables()
+    {
+        for (int i = 0; i <= exp2Steps; ++i)
+            exp2Frac[i] = std::exp2(1.0 * i / exp2Steps);
+        for (int n = noteMin; n <= noteMax; ++n)
+            noteFreq[n - noteMin] = 440.0 * std::exp2((n - 69.0) / 12.0);
+        for (int i = 0; i <= tanSteps; ++i)
+        {
+            auto t = std::tan(pival * tanMaxW * i / tanSteps);
+            tanValue[i] = t;
+            tanSlope[i] = pival * (1 + t * t);
+        }
+    }
+} tables;
+
+std::atomic<Precision> precision{Precision::Approximate};
+
+// floor as an int without the libm call (std::floor isn't inlined without SSE4.1)
+inline int floorInt(double x)
+{
+    auto i = (int)x;
+    return i - (x < i);
+}
+
+// 2^n for an integer n by building the exponent bits directly
+inline double pow2Int(int n)
+{
+    if (n < -1022 || n > 1023)
+        return std::ldexp(1.0, n);
+    uint64_t bits = (uint64_t)(n + 1023) << 52;
+    double r;
+    memcpy(&r, &bits, sizeof(r));
+    return r;
+}
+
+// 2^(y / ln2) = e^y for the small y left after the table lookups
+inline double expSmallCubic(double y) { return 1.0 + y * (1.0 + y * (0.5 + y * (1.0 / 6.0))); }
+inline double expSmallQuartic(double y)
+{
+    return 1.0 + y * (1.0 + y * (0.5 + y * (1.0 / 6.0 + y * (1.0 / 24.0))));
+}
+} // namespace
+
+Precision activePrecision() { return precision; }
+void selectPrecision(Precision p) { precision = p; }
+
+double exp2Approx(double x)
+{
+    // Outside this range the result is 0 or inf anyway and the int conversion would overflow
+    if (!(x > -2000.0 && x < 2000.0))
+        return std::exp2(x);
+
+    auto fl = floorInt(x);
+    auto fr = (x - fl) * exp2Steps;
+    auto i = (int)fr;
+    auto r = (fr - i) * (ln2 / exp2Steps);
+    return tables.exp2Frac[i] * expSmallCubic(r) * pow2Int(fl);
+}
+
+double noteToFreqApprox(double note)
+{
+    if (!(note >= noteMin && note < noteMax))
+        return 440.0 * exp2Approx((note - 69.0) / 12.0);
+
+    auto fl = floorInt(note);
+    auto r = (note - fl) * (ln2 / 12.0);
+    return tables.noteFreq[fl - noteMin] * expSmallQuartic(r);
+}
+
+double tanPrewarpApprox(double w)
+{
+    if (!(w > 0))
+        return 0;
+    if (w >= tanMaxW)
+        return tanPrewarpExact(w);
+
+    auto x = w * (tanSteps / tanMaxW);
+    auto i = (int)x;
+    auto t = x - i;
+    auto h = tanMaxW / tanSteps;
+
+    // Cubic Hermite on the knots either side
+    auto t2 = t * t, t3 = t2 * t;
+    auto h00 = 2 * t3 - 3 * t2 + 1, h10 = t3 - 2 * t2 + t;
+    auto h01 = -2 * t3 + 3 * t2, h11 = t3 - t2;
+    return h00 * tables.tanValue[i] + h10 * h * tables.tanSlope[i] +
+           h01 * tables.tanValue[i + 1] + h11 * h * tables.tanSlope[i + 1];
+}
+
+double exp2Exact(double x) { return std::exp2(x); }
+double noteToFreqExact(double note) { return 440.0 * std::pow(2.0, (note - 69.0) / 12.0); }
+double tanPrewarpExact(double w) { return std::tan(pival * w); }
+
+double exp2(double x) { return exp2(x, precision.load(std::memory_order_relaxed)); }
+double noteToFreq(double note)
+{
+    return noteToFreq(note, precision.load(std::memory_order_relaxed));
+}
+double tanPrewarp(double w) { return tanPrewarp(w, precision.load(std::memory_order_relaxed)); }
+
+double exp2(double x, Precision p)
+{
+    if (p == Precision::Exact)
+        return exp2Exact(x);
+    return exp2Approx(x);
+}
+
+double noteToFreq(double note, Precision p)
+{
+    if (p == Precision::Exact)
+        return noteToFreqExact(note);
+    return noteToFreqApprox(note);
+}
+
+double tanPrewarp(double w, Precision p)
+{
+    if (p == Precision::Exact)
+        return tanPrewarpExact(w);
+    return tanPrewarpApprox(w);
+}
+} // namespace sst::clap_saw_demo::fast_math
@@ -0,0 +1,63 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_FAST_MATH_H
+#define CLAP_SAW_DEMO_FAST_MATH_H
+
+/*
+ * fast_math holds the transcendental functions the voices need when they recalculate
+ * their pitch and filter coefficients. Each one has a table based approximation and the
+ * exact libm version, and the precision mode picks which the voices use. Approximate is the
+ * default; Exact is there so you can A/B the two and for renders where cost doesn't matter.
+ *
+ * The error bounds below are the worst case relative error measured over the domain
+ * against the double precision libm result.
+ *
+ * - exp2(x): 64 entry table of 2^(i/64) and a cubic for the remainder. Relative error
+ *   below 6e-10 (a millionth of a cent as a pitch ratio) for any x.
+ * - noteToFreq(n): 440 * 2^((n - 69) / 12) from a table of the integer notes -128...254
+ *   and a quartic for the fraction. Relative error below 6e-9 (ten millionths of a cent)
+ *   in the table range, and exp2's bound outside it.
+ * - tanPrewarp(w): tan(pi * w) for a normalised frequency w = f / sampleRate from a 512
+ *   step cubic Hermite table on [0, 0.45]. Relative error below 6e-9, far below anything
+ *   audible in the filter response. Above 0.45 (only reachable at low sample rates) it is
+ *   exact.
+ */
+
+namespace sst::clap_saw_demo::fast_math
+{
+enum class Precision
+{
+    Approximate,
+    Exact
+};
+
+Precision activePrecision();
+void selectPrecision(Precision p); // main thread only; applies from the next recalculation
+
+double exp2Approx(double x);
+double noteToFreqApprox(double note);
+double tanPrewarpApprox(double w);
+
+double exp2Exact(double x);
+double noteToFreqExact(double note);
+double tanPrewarpExact(double w);
+
+// These dispatch on the active precision
+double exp2(double x);
+double noteToFreq(double note);
+double tanPrewarp(double w);
+
+// and these on the one you ask for, for callers which override the global choice
+double exp2(double x, Precision p);
+double noteToFreq(double note, Precision p);
+double tanPrewarp(double w, Precision p);
+} // namespace sst::clap_saw_demo::fast_math
+
+#endif // CLAP_SAW_DEMO_FAST_MATH_H
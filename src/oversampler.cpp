@@ -0,0 +1,184 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#include "oversampler.h"
+#include "simd-f4.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace sst::clap_saw_demo
+{
+namespace
+{
+static constexpr double pival = 3.14159265358979323846;
+static constexpr double kaiserBeta = 8.0;
+
+// The zeroth order modified Bessel function, for the Kaiser window
+double besselI0(double x)
+{
+    double sum{1.0}, term{1.0};
+    for (int k = 1; k < 50; ++k)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-17)
+            break;
+    }
+    return sum;
+}
+
+/*
+ * The non-zero taps either side of the centre, found once when the library loads.
+ * oddTaps[j] is the coefficient centre +/- (2j + 1); the centre tap is exactly 1/2.
+ */
+struct HalfBandCoefficients
+{
+    static constexpr int count = HalfBandDecimator::sideTaps;
+    float oddTaps[count];
+
+    HalfBandCoefficients()
+    {
+        auto c = HalfBandDecimator::centre;
+        for (int j = 0; j < count; ++j)
+        {
+            auto n = 2 * j + 1;
+            auto sinc = std::sin(pival * n / 2) / (pival * n);
+            auto r = 1.0 * n / c;
+            auto window = besselI0(kaiserBeta * std::sqrt(1 - r * r)) / besselI0(kaiserBeta);
+            oddTaps[j] = (float)(sinc * window);
+        }
+    }
+} coefficients;
+} // namespace
+
+void HalfBandDecimator::reset()
+{
+    memset(evenPhase, 0, sizeof(evenPhase));
+    memset(oddPhase, 0, sizeof(oddPhase));
+}
+
+bool HalfBandDecimator::isFlushed() const
+{
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        for (int i = 0; i < evenHistory; ++i)
+            if (evenPhase[ch][i] != 0.f)
+                return false;
+        for (int i = 0; i < oddHistory; ++i)
+            if (oddPhase[ch][i] != 0.f)
+                return false;
+    }
+    return true;
+}
+
+/*
+ * The phase buffers hold one chunk, so longer input goes through in pieces. Each piece's
+ * output lands at or before the start of its input, so with out aliasing in a piece never
+ * writes over input a later piece has still to read.
+ */
+void HalfBandDecimator::process(const float *inL, const float *inR, float *outL, float *outR,
+                                int inFrames)
+{
+    assert(inFrames % 2 == 0);
+    for (int done = 0; done < inFrames; done += maxInput)
+    {
+        auto n = std::min(maxInput, inFrames - done);
+        processChunk(inL + done, inR + done, outL + done / 2, outR + done / 2, n);
+    }
+}
+
+void HalfBandDecimator::processChunk(const float *inL, const float *inR, float *outL,
+                                     float *outR, int inFrames)
+{
+    assert(inFrames <= maxInput);
+    const float *in[2]{inL, inR};
+    float *out[2]{outL, outR};
+    auto outFrames = inFrames / 2;
+
+    f4_t c4[sideTaps];
+    for (int j = 0; j < sideTaps; ++j)
+        c4[j] = f4Set1(coefficients.oddTaps[j]);
+    const auto half4 = f4Set1(0.5f);
+
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        auto *e = evenPhase[ch], *o = oddPhase[ch];
+        for (int m = 0; m < outFrames; ++m)
+        {
+            e[evenHistory + m] = in[ch][2 * m];
+            o[oddHistory + m] = in[ch][2 * m + 1];
+        }
+
+        /*
+         * Output m sits at input 2m in time and its newest tap is input 2m + 1, which puts
+         * the centre tap at e[m] and the taps centre -/+ (2j + 1) at o[m + 15 - j] and
+         * o[m + 16 + j] in the phase buffers.
+         */
+        int m = 0;
+        for (; m + 4 <= outFrames; m += 4)
+        {
+            auto sum = f4Mul(half4, f4LoadU(e + m));
+            for (int j = 0; j < sideTaps; ++j)
+            {
+                auto pair = f4Add(f4LoadU(o + m + sideTaps - 1 - j), f4LoadU(o + m + sideTaps + j));
+                sum = f4Add(sum, f4Mul(c4[j], pair));
+            }
+            f4StoreU(out[ch] + m, sum);
+        }
+        for (; m < outFrames; ++m)
+        {
+            float sum = 0.5f * e[m];
+            for (int j = 0; j < sideTaps; ++j)
+                sum += coefficients.oddTaps[j] * (o[m + sideTaps - 1 - j] + o[m + sideTaps + j]);
+            out[ch][m] = sum;
+        }
+
+        memmove(e, e + outFrames, evenHistory * sizeof(float));
+        memmove(o, o + outFrames, oddHistory * sizeof(float));
+    }
+}
+
+void Decimator::reset(int f)
+{
+    factor = (f == 2 || f == 4) ? f : 1;
+    for (auto &s : stages)
+        s.reset();
+}
+
+void Decimator::process(float *L, float *R, int outFrames)
+{
+    if (factor >= 4)
+        stages[0].process(L, R, L, R, outFrames * 4);
+    if (factor >= 2)
+        stages[1].process(L, R, L, R, outFrames * 2);
+}
+
+bool Decimator::isFlushed() const
+{
+    if (factor >= 4 && !stages[0].isFlushed())
+        return false;
+    if (factor >= 2 && !stages[1].isFlushed())
+        return false;
+    return true;
+}
+
+int Decimator::latency() const
+{
+    // Each stage delays by centre - 1 samples at its own input rate
+    static constexpr double stageDelay = HalfBandDecimator::centre - 1;
+    double delay{0};
+    if (factor >= 4)
+        delay += stageDelay / 4;
+    if (factor >= 2)
+        delay += stageDelay / 2;
+    return (int)delay;
+}
+} // namespace sst::clap_saw_demo
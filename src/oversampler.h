@@ -0,0 +1,86 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_OVERSAMPLER_H
+#define CLAP_SAW_DEMO_OVERSAMPLER_H
+
+/*
+ * The high quality offline path runs the voices at 2x or 4x the host sample rate, which
+ * pushes the saw's aliasing and the filter's frequency warping up out of the audible band,
+ * and then brings the bus back down to the host rate with the Decimator.
+ *
+ * It runs on the summed stereo bus, after the voices, so its cost goes with the number of
+ * output channels rather than the number of voices playing.
+ *
+ * Each halving is a HalfBandDecimator: a 63 tap Kaiser windowed (beta 8) half-band FIR
+ * lowpass followed by dropping every other sample. In a half-band filter every second tap
+ * is zero apart from the centre one, so it is computed in polyphase form: the input is split
+ * into its even and odd samples, the odd phase runs through the 32 non-zero side taps and
+ * the even phase only meets the centre tap. Only the outputs we keep are ever computed, at
+ * 17 multiplies per output per channel, four outputs at a time in SIMD. The
+ * passband is flat within 0.003dB to 0.21 of the input rate (20kHz at 48k) and the stopband
+ * is below -70dB from 0.29 and -80dB from 0.3. 4x is two halvings in series.
+ *
+ * The filter is linear phase, so the decimator delays the signal by a fixed amount which
+ * the synth reports to the host as latency.
+ */
+
+namespace sst::clap_saw_demo
+{
+struct HalfBandDecimator
+{
+    static constexpr int taps = 63;
+    static constexpr int centre = taps / 2;
+    static constexpr int sideTaps = (taps + 1) / 4; // non-zero taps either side of the centre
+    static constexpr int maxInput = 1024; // ClapSawDemo::renderSpanFrames, one render span
+
+    void reset();
+
+    // True when the history is all zeros, so silent input gives silent output
+    bool isFlushed() const;
+
+    // Filter and decimate inFrames (even) samples, maxInput at a time. out may alias in.
+    void process(const float *inL, const float *inR, float *outL, float *outR, int inFrames);
+
+  private:
+    void processChunk(const float *inL, const float *inR, float *outL, float *outR,
+                      int inFrames);
+
+    /*
+     * The input split into its even and odd samples, each the history the filter needs
+     * followed by this call's input. Only the centre tap touches the even phase.
+     */
+    static constexpr int evenHistory = (centre - 1) / 2, oddHistory = 2 * sideTaps - 1;
+    float evenPhase[2][evenHistory + maxInput / 2];
+    float oddPhase[2][oddHistory + maxInput / 2];
+};
+
+struct Decimator
+{
+    // factor is 1, 2, or 4. A factor of 1 passes the signal straight through.
+    void reset(int factor);
+    int getFactor() const { return factor; }
+
+    // Decimate factor * outFrames samples of L and R in place to outFrames samples
+    void process(float *L, float *R, int outFrames);
+
+    // True when silent input would give silent output straight away
+    bool isFlushed() const;
+
+    // The delay the filters add, in output samples, rounded down. At 4x that is 22.5, and
+    // rounding down lines the result up with the plain rate render to within a sample.
+    int latency() const;
+
+  private:
+    int factor{1};
+    HalfBandDecimator stages[2];
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_OVERSAMPLER_H
@@ -0,0 +1,108 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_PARAM_REGISTRY_H
+#define CLAP_SAW_DEMO_PARAM_REGISTRY_H
+
+/*
+ * The parameter registry is the one description of every parameter: its id, range, default,
+ * clap flags and how it shows as text. ClapSawDemo keeps its table as a constexpr array (see
+ * ClapSawDemo::paramDefs) and everything else, paramsInfo, the text conversions, the state
+ * and the editor's slider scaling, reads from it.
+ *
+ * The values themselves live in a flat array in the same order as the table, so the only
+ * question at runtime is which index an id has. ParamIndex answers that from a copy of the
+ * ids sorted at compile time, with a binary search which compiles to a handful of compares
+ * and conditional moves and no branches on the data. An id which isn't in the table comes
+ * back as -1, so an event for a parameter we don't have can be dropped rather than written
+ * somewhere it shouldn't be.
+ */
+
+#include <cstdint>
+#include <clap/clap.h>
+
+namespace sst::clap_saw_demo
+{
+// How a value is shown to (and parsed from) the user. The formatting is in paramsValueToText.
+enum class ParamFormat
+{
+    Plain,
+    Voices,
+    Cents,
+    Seconds,       // 0-1 mapped through scaleTimeParamToSeconds
+    Keys,          // 12-TET MIDI note, shown in Hz
+    Milliseconds,
+    Gate,
+    FilterMode,
+    StealMode,
+    Oversampling
+};
+
+struct ParamDef
+{
+    clap_id id;
+    const char *name;
+    const char *module;
+    double minValue, maxValue, defaultValue;
+    uint32_t flags;
+    ParamFormat format;
+
+    // The editor's sliders run 0...1 across the range
+    constexpr double normalise(double v) const
+    {
+        return (v - minValue) / (maxValue - minValue);
+    }
+    constexpr double denormalise(double n) const { return minValue + n * (maxValue - minValue); }
+};
+
+template <int N> struct ParamIndex
+{
+    clap_id sortedIds[N]{};
+    int sortedIndex[N]{};
+
+    // An insertion sort, since std::sort isn't constexpr until C++20
+    constexpr explicit ParamIndex(const ParamDef (&defs)[N])
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            int j = i;
+            for (; j > 0 && sortedIds[j - 1] > defs[i].id; --j)
+            {
+                sortedIds[j] = sortedIds[j - 1];
+                sortedIndex[j] = sortedIndex[j - 1];
+            }
+            sortedIds[j] = defs[i].id;
+            sortedIndex[j] = i;
+        }
+    }
+
+    constexpr bool idsAreUnique() const
+    {
+        for (int i = 1; i < N; ++i)
+            if (sortedIds[i - 1] == sortedIds[i])
+                return false;
+        return true;
+    }
+
+    // The index of id in the table, or -1 if it isn't a parameter of ours
+    constexpr int indexOf(clap_id id) const
+    {
+        int base = 0, n = N;
+        while (n > 1)
+        {
+            int half = n / 2;
+            base = (sortedIds[base + half] <= id) ? base + half : base;
+            n -= half;
+        }
+        return sortedIds[base] == id ? sortedIndex[base] : -1;
+    }
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_PARAM_REGISTRY_H
@@ -0,0 +1,62 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_PARAM_SMOOTHER_H
+#define CLAP_SAW_DEMO_PARAM_SMOOTHER_H
+
+/*
+ * ParamSmoother is a linear ramp from a parameter's current value to its latest target,
+ * advanced once per control tick rather than once per sample. The engine ticks its smoothers
+ * every ClapSawDemo::controlRate samples and only then pushes the new values into the voices,
+ * so a dense automation curve costs one coefficient recalculation per tick instead of one per
+ * event, and a jump in a parameter becomes a short ramp instead of a zipper step.
+ */
+
+namespace sst::clap_saw_demo
+{
+struct ParamSmoother
+{
+    float value{0.f}, target{0.f}, step{0.f};
+    int ticksLeft{0};
+
+    // Jump straight to v with no ramp
+    void snap(float v)
+    {
+        value = v;
+        target = v;
+        ticksLeft = 0;
+    }
+
+    // Head towards t over `ticks` control ticks. Zero ticks jumps there immediately.
+    void setTarget(float t, int ticks)
+    {
+        target = t;
+        if (ticks <= 0)
+        {
+            snap(t);
+            return;
+        }
+        step = (target - value) / ticks;
+        ticksLeft = ticks;
+    }
+
+    bool isMoving() const { return ticksLeft > 0; }
+
+    // Advance one control tick, landing exactly on the target at the end of the ramp
+    void tick()
+    {
+        if (ticksLeft <= 0)
+            return;
+        ticksLeft--;
+        value = ticksLeft == 0 ? target : value + step;
+    }
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_PARAM_SMOOTHER_H
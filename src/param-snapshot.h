@@ -0,0 +1,65 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_PARAM_SNAPSHOT_H
+#define CLAP_SAW_DEMO_PARAM_SNAPSHOT_H
+
+/*
+ * ParamSnapshotBuffer hands a complete set of parameter values from the main thread to the
+ * audio thread, which is how a state load reaches the engine while it is running. The main
+ * thread fills a snapshot and publishes it, and the audio thread picks up the newest one at
+ * the start of its next block, so the engine sees either the old patch or the new one and
+ * never half of each.
+ *
+ * It is a triple buffer. The main thread owns one slot, the audio thread another, and the
+ * third sits in an atomic along with a bit saying whether it holds something the audio thread
+ * hasn't seen. Publishing and adopting are each a single atomic exchange of slot indices, so
+ * neither side ever waits for the other or allocates. With only two slots the main thread
+ * could be writing the one the audio thread is still copying from; the third is what lets it
+ * always have a free one. A snapshot published before the audio thread got to the previous
+ * one simply replaces it.
+ */
+
+#include <atomic>
+
+namespace sst::clap_saw_demo
+{
+template <int N> class ParamSnapshotBuffer
+{
+  public:
+    // Main thread: fill this in and then publish it
+    double *writeBuffer() { return slots[writeSlot].values; }
+    void publish()
+    {
+        writeSlot = shared.exchange(writeSlot | fresh, std::memory_order_acq_rel) & slotMask;
+    }
+
+    // Audio thread: the newest published values, or nullptr if nothing new since the last call
+    const double *adopt()
+    {
+        if (!(shared.load(std::memory_order_relaxed) & fresh))
+            return nullptr;
+        readSlot = shared.exchange(readSlot, std::memory_order_acq_rel) & slotMask;
+        return slots[readSlot].values;
+    }
+
+  private:
+    static constexpr int slotMask = 3, fresh = 4;
+
+    struct alignas(64) Slot
+    {
+        double values[N]{};
+    };
+    Slot slots[3];
+    int writeSlot{0}, readSlot{1};
+    std::atomic<int> shared{2};
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_PARAM_SNAPSHOT_H
@@ -0,0 +1,324 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#include "preset-bank.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sst::clap_saw_demo
+{
+namespace
+{
+static constexpr char bankMagic[4] = {'C', 'S', 'D', 'B'};
+static constexpr uint64_t headerSize = 40, indexEntrySize = 16;
+
+uint32_t readU32(const uint8_t *p)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+uint64_t readU64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+double readF64(const uint8_t *p)
+{
+    auto bits = readU64(p);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+void putU32(std::vector<uint8_t> &out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back((uint8_t)(v >> (8 * i)));
+}
+void putU64(std::vector<uint8_t> &out, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back((uint8_t)(v >> (8 * i)));
+}
+void putF64(std::vector<uint8_t> &out, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    putU64(out, bits);
+}
+
+// Does [offset, offset + count * each) fit in size, without overflowing on the way
+bool fits(uint64_t offset, uint64_t count, uint64_t each, uint64_t size)
+{
+    if (offset > size)
+        return false;
+    return each == 0 || count <= (size - offset) / each;
+}
+} // namespace
+
+#if defined(_WIN32)
+bool MappedFile::open(const char *path)
+{
+    close();
+    error = 0;
+
+    // Paths arrive as UTF-8
+    auto wlen = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+    if (wlen <= 0)
+    {
+        error = (int32_t)GetLastError();
+        return false;
+    }
+    std::wstring wpath(wlen, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath.data(), wlen);
+
+    auto f = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE)
+    {
+        error = (int32_t)GetLastError();
+        return false;
+    }
+    fileHandle = f;
+
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(f, &sz))
+        error = (int32_t)GetLastError();
+    else if (sz.QuadPart <= 0)
+        error = ERROR_HANDLE_EOF; // there's nothing to map in an empty file
+    if (error)
+    {
+        close();
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+        error = (int32_t)GetLastError();
+        close();
+        return false;
+    }
+    bytes = (const uint8_t *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!bytes)
+    {
+        error = (int32_t)GetLastError();
+        close();
+        return false;
+    }
+    length = (size_t)sz.QuadPart;
+    error = 0;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+    bytes = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+}
+#else
+bool MappedFile::open(const char *path)
+{
+    close();
+    error = 0;
+
+    auto fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        error = errno;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        error = errno;
+    else if (st.st_size <= 0)
+        error = EINVAL; // there's nothing to map in an empty file
+    if (error)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file alive, so we don't need the descriptor past here
+    auto *m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+    {
+        error = errno;
+        return false;
+    }
+    bytes = (const uint8_t *)m;
+    length = (size_t)st.st_size;
+    error = 0;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+        munmap((void *)bytes, length);
+    bytes = nullptr;
+    length = 0;
+}
+#endif
+
+bool PresetBank::open(const char *path)
+{
+    nPresets = 0;
+    nParams = 0;
+    if (!file.open(path))
+        return fail("Unable to open the preset bank");
+
+    auto *d = file.data();
+    auto size = (uint64_t)file.size();
+    if (size < headerSize || memcmp(d, bankMagic, sizeof(bankMagic)) != 0)
+        return fail("Not a ClapSawDemo preset bank");
+    if (readU32(d + 4) > version)
+        return fail("The preset bank is from a newer version of ClapSawDemo");
+
+    auto presets = readU32(d + 8);
+    auto params = readU32(d + 12);
+    idsOffset = readU64(d + 16);
+    indexOffset = readU64(d + 24);
+    valuesOffset = readU64(d + 32);
+
+    if (!fits(idsOffset, params, sizeof(uint32_t), size) ||
+        !fits(indexOffset, presets, indexEntrySize, size) ||
+        (params > 0 && !fits(valuesOffset, presets, (uint64_t)params * sizeof(double), size)))
+        return fail("The preset bank is damaged");
+
+    nPresets = presets;
+    nParams = params;
+    message = "";
+    return true;
+}
+
+const char *PresetBank::name(uint32_t preset) const
+{
+    if (preset >= nPresets)
+        return nullptr;
+    auto *entry = file.data() + indexOffset + preset * indexEntrySize;
+    auto offset = readU64(entry);
+    auto len = readU32(entry + 8);
+
+    // The name and its terminator have to be in the file
+    if (!fits(offset, (uint64_t)len + 1, 1, file.size()) || file.data()[offset + len] != 0)
+        return nullptr;
+    return (const char *)(file.data() + offset);
+}
+
+clap_id PresetBank::paramId(uint32_t param) const
+{
+    if (param >= nParams)
+        return CLAP_INVALID_ID;
+    return readU32(file.data() + idsOffset + param * sizeof(uint32_t));
+}
+
+double PresetBank::value(uint32_t preset, uint32_t param) const
+{
+    if (preset >= nPresets || param >= nParams)
+        return 0;
+    auto row = valuesOffset + (uint64_t)preset * nParams * sizeof(double);
+    return readF64(file.data() + row + param * sizeof(double));
+}
+
+bool writePresetBank(const char *path, const std::vector<clap_id> &ids,
+                     const std::vector<PresetBankEntry> &presets)
+{
+    for (const auto &p : presets)
+        if (p.values.size() != ids.size())
+            return false;
+
+    uint64_t idsOffset = headerSize;
+    uint64_t indexOffset = idsOffset + ids.size() * sizeof(uint32_t);
+    uint64_t valuesOffset = indexOffset + presets.size() * indexEntrySize;
+    uint64_t namesOffset = valuesOffset + presets.size() * ids.size() * sizeof(double);
+
+    std::vector<uint8_t> out;
+    out.insert(out.end(), bankMagic, bankMagic + sizeof(bankMagic));
+    putU32(out, PresetBank::version);
+    putU32(out, (uint32_t)presets.size());
+    putU32(out, (uint32_t)ids.size());
+    putU64(out, idsOffset);
+    putU64(out, indexOffset);
+    putU64(out, valuesOffset);
+
+    for (auto id : ids)
+        putU32(out, id);
+
+    auto nameAt = namesOffset;
+    for (const auto &p : presets)
+    {
+        putU64(out, nameAt);
+        putU32(out, (uint32_t)p.name.size());
+        putU32(out, 0);
+        nameAt += p.name.size() + 1;
+    }
+
+    for (const auto &p : presets)
+        for (auto v : p.values)
+            putF64(out, v);
+
+    for (const auto &p : presets)
+        out.insert(out.end(), p.name.c_str(), p.name.c_str() + p.name.size() + 1);
+
+    auto *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    auto ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    return (fclose(f) == 0) && ok;
+}
+
+std::string presetBankDirectory()
+{
+#if defined(_WIN32)
+    auto *appData = getenv("APPDATA");
+    if (!appData || !*appData)
+        return {};
+    return std::string(appData) + "\\ClapSawDemo\\Banks";
+#elif defined(__APPLE__)
+    auto *home = getenv("HOME");
+    if (!home || !*home)
+        return {};
+    return std::string(home) + "/Library/Application Support/ClapSawDemo/Banks";
+#else
+    auto *xdg = getenv("XDG_DATA_HOME");
+    if (xdg && *xdg)
+        return std::string(xdg) + "/ClapSawDemo/Banks";
+    auto *home = getenv("HOME");
+    if (!home || !*home)
+        return {};
+    return std::string(home) + "/.local/share/ClapSawDemo/Banks";
+#endif
+}
+} // namespace sst::clap_saw_demo
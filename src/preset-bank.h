@@ -0,0 +1,118 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_PRESET_BANK_H
+#define CLAP_SAW_DEMO_PRESET_BANK_H
+
+/*
+ * A preset bank is one file holding any number of presets, so a sound designer can ship
+ * thousands of patches as a handful of files. Hosts find the banks through the preset
+ * discovery factory (clap-saw-demo-pluginentry.cpp) and load a preset from one through the
+ * preset-load extension, with the preset's number in the bank as the load key.
+ *
+ * The file is memory mapped and read lazily. Opening a bank checks the header and that the
+ * tables it points at fit in the file, and nothing more; a name or a preset's values are only
+ * touched when someone asks for them, so indexing a large bank reads the names and a load
+ * reads one row. Everything is little endian.
+ *
+ *   offset  size
+ *        0     4  magic "CSDB"
+ *        4     4  version (1)
+ *        8     4  presetCount
+ *       12     4  paramCount
+ *       16     8  idsOffset     paramCount u32 param ids, shared by every preset
+ *       24     8  indexOffset   presetCount entries of {u64 nameOffset, u32 nameLength,
+ *                               u32 reserved}; the name is UTF-8 followed by a zero byte
+ *       32     8  valuesOffset  presetCount rows of paramCount f64 values, in ids order
+ *
+ * A bank written by a different version of the synth may have ids we don't know, which a
+ * load skips, and may lack ones we do, which a load leaves at their defaults.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <clap/clap.h>
+
+namespace sst::clap_saw_demo
+{
+// A read only view of a whole file, unmapped when it goes away
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const char *path); // on failure osError() says why
+    void close();
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return length; }
+    int32_t osError() const { return error; }
+
+  private:
+    const uint8_t *bytes{nullptr};
+    size_t length{0};
+    int32_t error{0};
+#if defined(_WIN32)
+    void *fileHandle{nullptr}, *mappingHandle{nullptr};
+#endif
+};
+
+class PresetBank
+{
+  public:
+    static constexpr const char *fileExtension = "csdbank";
+    static constexpr uint32_t version = 1;
+
+    // Maps the file and checks its layout. On failure errorMessage() and osError() say why.
+    bool open(const char *path);
+
+    uint32_t presetCount() const { return nPresets; }
+    uint32_t paramCount() const { return nParams; }
+
+    // The preset's name, or nullptr if the entry is damaged. Points into the mapping.
+    const char *name(uint32_t preset) const;
+    clap_id paramId(uint32_t param) const;
+    double value(uint32_t preset, uint32_t param) const;
+
+    const char *errorMessage() const { return message; }
+    int32_t osError() const { return file.osError(); }
+
+  private:
+    bool fail(const char *m)
+    {
+        message = m;
+        file.close();
+        return false;
+    }
+
+    MappedFile file;
+    uint32_t nPresets{0}, nParams{0};
+    uint64_t idsOffset{0}, indexOffset{0}, valuesOffset{0};
+    const char *message{"Not open"};
+};
+
+struct PresetBankEntry
+{
+    std::string name;
+    std::vector<double> values; // one per id passed to writePresetBank
+};
+
+// Write a bank. This is for tools; the plugin only ever reads them.
+bool writePresetBank(const char *path, const std::vector<clap_id> &ids,
+                     const std::vector<PresetBankEntry> &presets);
+
+// Where the banks live: <user data>/ClapSawDemo/Banks. Empty if we can't tell.
+std::string presetBankDirectory();
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_PRESET_BANK_H
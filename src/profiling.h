@@ -0,0 +1,313 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_PROFILING_H
+#define CLAP_SAW_DEMO_PROFILING_H
+
+/*
+ * Profiler is instrumentation which is safe to use on the audio thread, for when you need to
+ * know why a host reports xruns. _DBGCOUT is no good there since it locks and allocates.
+ *
+ * Each process call the synth times its stages (event handling, voice rendering, and the
+ * terminated voice sweep) and counts events by type, voice steals, messages the UI queue
+ * dropped, and output events the host refused. At the end of the call the Profiler
+ *
+ * - pushes the block's record into a single producer / single consumer ring; if the reader
+ *   has fallen behind the record is dropped (and counted) rather than waiting
+ * - adds the block's CPU time, as a fraction of the realtime budget for its frames, to a
+ *   histogram and adds its counts to running totals
+ *
+ * All of that is wait-free: relaxed atomics with a single writer and no locks. The main
+ * thread can pop records and read the histogram and totals whenever it likes;
+ * ClapSawDemo prints a summary when it is deactivated.
+ *
+ * Configure with CSD_ENABLE_PROFILING to turn it on. Otherwise every method is an empty
+ * inline and the profiler compiles out completely.
+ */
+
+#ifndef CSD_ENABLE_PROFILING
+#define CSD_ENABLE_PROFILING 0
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+
+#include <clap/clap.h>
+
+namespace sst::clap_saw_demo::profiling
+{
+enum Timer
+{
+    tmEvents,
+    tmRender,
+    tmTerminate,
+    tmProcess, // the whole process call
+    nTimers
+};
+
+enum Counter
+{
+    ctNoteOn,
+    ctNoteOff,
+    ctNoteChoke,
+    ctNoteExpression,
+    ctParamValue,
+    ctParamMod,
+    ctMidi,
+    ctOtherEvent,
+    ctVoiceSteal,
+    ctToUiDropped,
+    ctTryPushFailed,
+    nCounters
+};
+
+inline const char *timerName(Timer t)
+{
+    static constexpr const char *names[nTimers] = {"events", "render", "terminate", "process"};
+    return names[t];
+}
+
+inline const char *counterName(Counter c)
+{
+    static constexpr const char *names[nCounters] = {
+        "note-on",   "note-off",  "note-choke",   "note-expression", "param-value",
+        "param-mod", "midi",      "other-events", "voice-steals",    "to-ui-dropped",
+        "try-push-failed"};
+    return names[c];
+}
+
+inline Counter counterForEvent(uint16_t type)
+{
+    switch (type)
+    {
+    case CLAP_EVENT_NOTE_ON:
+        return ctNoteOn;
+    case CLAP_EVENT_NOTE_OFF:
+        return ctNoteOff;
+    case CLAP_EVENT_NOTE_CHOKE:
+        return ctNoteChoke;
+    case CLAP_EVENT_NOTE_EXPRESSION:
+        return ctNoteExpression;
+    case CLAP_EVENT_PARAM_VALUE:
+        return ctParamValue;
+    case CLAP_EVENT_PARAM_MOD:
+        return ctParamMod;
+    case CLAP_EVENT_MIDI:
+        return ctMidi;
+    }
+    return ctOtherEvent;
+}
+
+// What the ring holds for each process call
+struct BlockRecord
+{
+    int64_t steadyTime{-1};
+    uint32_t frames{0};
+    uint64_t timerNs[nTimers]{};
+    uint32_t counts[nCounters]{};
+};
+
+/*
+ * The histogram has a bucket for each 5% of the block's realtime budget and a final bucket
+ * for blocks which took longer than realtime; anything landing there is an xrun waiting to
+ * happen on a loaded machine.
+ */
+static constexpr int histogramBuckets = 21;
+static constexpr int ringSize = 256;
+
+using profileClock = std::chrono::steady_clock;
+
+#if CSD_ENABLE_PROFILING
+struct Profiler
+{
+    static constexpr bool enabled = true;
+
+    // Main thread, while the audio thread isn't running (from activate)
+    void reset(double sr)
+    {
+        sampleRate = sr;
+        current = BlockRecord();
+        writePos = 0;
+        readPos = 0;
+        for (auto &h : histogram)
+            h = 0;
+        for (auto &t : totals)
+            t = 0;
+        blocks = 0;
+        droppedRecords = 0;
+        maxBudget = 0;
+    }
+
+    // Audio thread
+    void beginBlock(int64_t steadyTime, uint32_t frames)
+    {
+        current = BlockRecord();
+        current.steadyTime = steadyTime;
+        current.frames = frames;
+        blockStart = profileClock::now();
+    }
+    void addTime(Timer t, profileClock::duration d)
+    {
+        current.timerNs[t] += std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    }
+    void count(Counter c, uint32_t n = 1) { current.counts[c] += n; }
+    void countEvent(uint16_t type) { count(counterForEvent(type)); }
+    void endBlock()
+    {
+        addTime(tmProcess, profileClock::now() - blockStart);
+
+        auto w = writePos.load(std::memory_order_relaxed);
+        if (w - readPos.load(std::memory_order_acquire) >= ringSize)
+        {
+            bump(droppedRecords, 1);
+        }
+        else
+        {
+            ring[w % ringSize] = current;
+            writePos.store(w + 1, std::memory_order_release);
+        }
+
+        if (current.frames > 0 && sampleRate > 0)
+        {
+            auto budget = current.timerNs[tmProcess] * 1e-9 * sampleRate / current.frames;
+            auto bucket = std::min((int)(budget * 20), histogramBuckets - 1);
+            bump(histogram[bucket], 1);
+            if (budget > maxBudget.load(std::memory_order_relaxed))
+                maxBudget.store(budget, std::memory_order_relaxed);
+        }
+        for (int c = 0; c < nCounters; ++c)
+            if (current.counts[c])
+                bump(totals[c], current.counts[c]);
+        bump(blocks, 1);
+    }
+
+    // Main thread
+    bool popRecord(BlockRecord &r)
+    {
+        auto rp = readPos.load(std::memory_order_relaxed);
+        if (rp == writePos.load(std::memory_order_acquire))
+            return false;
+        r = ring[rp % ringSize];
+        readPos.store(rp + 1, std::memory_order_release);
+        return true;
+    }
+    uint64_t histogramCount(int bucket) const { return histogram[bucket]; }
+    uint64_t total(Counter c) const { return totals[c]; }
+    uint64_t blockCount() const { return blocks; }
+    uint64_t droppedRecordCount() const { return droppedRecords; }
+    double maxBudgetUsed() const { return maxBudget; }
+
+    // Drain the ring and write a summary of everything since the last reset
+    void report(std::ostream &os)
+    {
+        uint64_t n{0}, sum[nTimers]{}, worst[nTimers]{};
+        BlockRecord r;
+        while (popRecord(r))
+        {
+            n++;
+            for (int t = 0; t < nTimers; ++t)
+            {
+                sum[t] += r.timerNs[t];
+                worst[t] = std::max(worst[t], r.timerNs[t]);
+            }
+        }
+
+        os << "[clap-saw-demo] profile: " << blockCount() << " blocks, worst "
+           << std::setprecision(3) << 100 * maxBudgetUsed() << "% of realtime\n";
+        if (n > 0)
+        {
+            os << "  last " << n << " blocks (mean / worst ns):";
+            for (int t = 0; t < nTimers; ++t)
+                os << " " << timerName((Timer)t) << " " << sum[t] / n << " / " << worst[t];
+            os << "\n";
+        }
+        os << "  counts:";
+        for (int c = 0; c < nCounters; ++c)
+            os << " " << counterName((Counter)c) << "=" << total((Counter)c);
+        os << " dropped-records=" << droppedRecordCount() << "\n";
+        os << "  budget histogram:";
+        for (int b = 0; b < histogramBuckets; ++b)
+        {
+            if (histogramCount(b) == 0)
+                continue;
+            if (b == histogramBuckets - 1)
+                os << " >100%:" << histogramCount(b);
+            else
+                os << " " << b * 5 << "-" << (b + 1) * 5 << "%:" << histogramCount(b);
+        }
+        os << std::endl;
+    }
+
+  private:
+    // Only the audio thread writes these so a load and store is enough to stay wait-free
+    template <typename T, typename V> static void bump(std::atomic<T> &a, V v)
+    {
+        a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+    double sampleRate{0};
+    BlockRecord current;
+    profileClock::time_point blockStart;
+
+    BlockRecord ring[ringSize];
+    std::atomic<uint32_t> writePos{0}, readPos{0};
+
+    std::atomic<uint64_t> histogram[histogramBuckets]{};
+    std::atomic<uint64_t> totals[nCounters]{};
+    std::atomic<uint64_t> blocks{0}, droppedRecords{0};
+    std::atomic<double> maxBudget{0};
+};
+#else
+struct Profiler
+{
+    static constexpr bool enabled = false;
+
+    void reset(double) {}
+    void beginBlock(int64_t, uint32_t) {}
+    void addTime(Timer, profileClock::duration) {}
+    void count(Counter, uint32_t = 1) {}
+    void countEvent(uint16_t) {}
+    void endBlock() {}
+    bool popRecord(BlockRecord &) { return false; }
+    uint64_t histogramCount(int) const { return 0; }
+    uint64_t total(Counter) const { return 0; }
+    uint64_t blockCount() const { return 0; }
+    uint64_t droppedRecordCount() const { return 0; }
+    double maxBudgetUsed() const { return 0; }
+    void report(std::ostream &) {}
+};
+#endif
+
+/*
+ * ScopeTimer adds the time until it goes out of scope to one of the profiler's timers.
+ * Repeated scopes within a block accumulate.
+ */
+#if CSD_ENABLE_PROFILING
+struct ScopeTimer
+{
+    ScopeTimer(Profiler &p, Timer t) : profiler(p), timer(t), start(profileClock::now()) {}
+    ~ScopeTimer() { profiler.addTime(timer, profileClock::now() - start); }
+
+    Profiler &profiler;
+    Timer timer;
+    profileClock::time_point start;
+};
+#else
+struct ScopeTimer
+{
+    ScopeTimer(Profiler &, Timer) {}
+};
+#endif
+} // namespace sst::clap_saw_demo::profiling
+
+#endif // CLAP_SAW_DEMO_PROFILING_H
@@ -0,0 +1,247 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#include "render-pool.h"
+#include "denormals.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace sst::clap_saw_demo
+{
+namespace
+{
+// How many times a worker checks for the next run before parking
+static constexpr int spinsBeforePark = 20000;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+} // namespace
+
+std::shared_ptr<RenderPool> RenderPool::acquireShared(int workers)
+{
+    static std::mutex sharedMutex;
+    static std::weak_ptr<RenderPool> shared;
+
+    std::lock_guard<std::mutex> g(sharedMutex);
+    auto pool = shared.lock();
+    if (!pool)
+    {
+        pool = std::make_shared<RenderPool>();
+        pool->start(workers);
+        shared = pool;
+    }
+    return pool;
+}
+
+void RenderPool::Deque::push(int task)
+{
+    auto b = bottom.load(std::memory_order_relaxed);
+    tasks[b & mask] = task;
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+bool RenderPool::Deque::pop(int &task)
+{
+    auto b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        // Already empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    task = tasks[b & mask];
+    if (t == b)
+    {
+        // The last task, so race any thieves for it through top
+        auto won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                               std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+RenderPool::Deque::StealResult RenderPool::Deque::steal(int &task)
+{
+    auto t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return EMPTY;
+
+    task = tasks[t & mask];
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+        return LOST_RACE;
+    return STOLEN;
+}
+
+void RenderPool::start(int workers)
+{
+    stop();
+    if (workers <= 0)
+        return;
+
+    quit = false;
+    checkedIn = 0;
+    deques = std::make_unique<Deque[]>(workers + 1);
+    threads.reserve(workers);
+
+    // Take the generation here, not in the thread, so a worker which is slow to start
+    // still joins the first run
+    auto gen = generation.load();
+    for (int i = 0; i < workers; ++i)
+        threads.emplace_back([this, i, gen]() { workerLoop(i + 1, gen); });
+}
+
+void RenderPool::stop()
+{
+    if (threads.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> g(parkMutex);
+        quit = true;
+    }
+    parkCondition.notify_all();
+    for (auto &t : threads)
+        t.join();
+    threads.clear();
+    deques.reset();
+}
+
+bool RenderPool::run(int nTasks, TaskFn fn, void *ctx)
+{
+    if (threads.empty() || nTasks <= 0 || nTasks > maxTasks)
+        return false;
+    if (inRun.exchange(true, std::memory_order_acquire))
+        return false;
+
+    // Every worker checked in at the end of the last run, so we have the deques to ourselves
+    auto participants = (int)threads.size() + 1;
+    for (int t = 0; t < nTasks; ++t)
+        deques[t % participants].push(t);
+    taskFn = fn;
+    taskCtx = ctx;
+    checkedIn.store(0, std::memory_order_relaxed);
+
+    // This publishes all of the above to the workers. If any of them might be parked we have to
+    // wake them; the seq_cst pair with the sleepers count in workerLoop means we can't miss one.
+    generation.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_seq_cst) > 0)
+    {
+        {
+            std::lock_guard<std::mutex> g(parkMutex);
+        }
+        parkCondition.notify_all();
+    }
+
+    work(0);
+
+    int spins{0};
+    while (checkedIn.load(std::memory_order_acquire) < (int)threads.size())
+    {
+        if (++spins < spinsBeforePark)
+            cpuRelax();
+        else
+            std::this_thread::yield();
+    }
+    inRun.store(false, std::memory_order_release);
+    return true;
+}
+
+void RenderPool::work(int participant)
+{
+    auto participants = (int)threads.size() + 1;
+    int task;
+    while (true)
+    {
+        if (deques[participant].pop(task))
+        {
+            taskFn(taskCtx, task);
+            continue;
+        }
+
+        /*
+         * Our deque is empty so look for work in the others. Losing a race for a task doesn't
+         * mean that deque is empty, so go around again until every deque has been seen empty.
+         * Since nothing is added during a run, at that point every task has been claimed.
+         */
+        bool stole{false}, lostRace{true};
+        while (!stole && lostRace)
+        {
+            lostRace = false;
+            for (int i = 1; i < participants && !stole; ++i)
+            {
+                switch (deques[(participant + i) % participants].steal(task))
+                {
+                case Deque::STOLEN:
+                    stole = true;
+                    break;
+                case Deque::LOST_RACE:
+                    lostRace = true;
+                    break;
+                case Deque::EMPTY:
+                    break;
+                }
+            }
+        }
+        if (!stole)
+            return;
+        taskFn(taskCtx, task);
+    }
+}
+
+void RenderPool::workerLoop(int participant, uint32_t seen)
+{
+    ScopedDenormalFlush denormalFlush; // our thread, so for its whole life
+
+    while (true)
+    {
+        int spins{0};
+        while (generation.load(std::memory_order_acquire) == seen &&
+               !quit.load(std::memory_order_acquire) && spins < spinsBeforePark)
+        {
+            cpuRelax();
+            spins++;
+        }
+
+        if (generation.load(std::memory_order_acquire) == seen &&
+            !quit.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lk(parkMutex);
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            while (generation.load(std::memory_order_seq_cst) == seen && !quit)
+                parkCondition.wait(lk);
+            sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        if (quit.load(std::memory_order_acquire))
+            return;
+
+        // run() waits for every worker between runs, so we can't have skipped a generation
+        seen = generation.load(std::memory_order_acquire);
+        work(participant);
+        checkedIn.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+} // namespace sst::clap_saw_demo
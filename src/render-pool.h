@@ -0,0 +1,116 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_RENDER_POOL_H
+#define CLAP_SAW_DEMO_RENDER_POOL_H
+
+/*
+ * RenderPool is the synth's own set of worker threads, used to render voice tasks in parallel
+ * when the host is bouncing offline (CLAP_RENDER_OFFLINE through clap_plugin_render) but
+ * doesn't offer a thread pool of its own.
+ *
+ * - Every participant in a run (each worker, and the thread calling run, which works too)
+ *   has a Chase-Lev deque of task indices. run() deals the tasks round robin into the deques
+ *   before waking anyone, so during a run the deques only shrink. Owners pop from the
+ *   bottom and anyone whose deque is empty steals from the top of the others.
+ * - A run finishes once every worker has checked in having found no more work, so no
+ *   worker is ever still looking at the deques when the next run deals into them.
+ * - Between runs the workers spin for a while, since in a bounce the next block follows
+ *   immediately, and then park on a condition variable. Waking a parked worker takes a
+ *   mutex, which is one reason the pool is only for offline rendering where the audio
+ *   thread has no realtime deadline.
+ *
+ * There is one pool per process, not per instance: a bounce with ten instances of the synth
+ * should still have one worker per core, not ten. Instances hold it through acquireShared
+ * while activated offline and the workers stop when the last one lets go. Only one instance
+ * can run on it at a time, and run() says no to the others, who render on their own thread.
+ * The workers aren't pinned to cores, since a plugin can't know what else the host has put
+ * there.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sst::clap_saw_demo
+{
+class RenderPool
+{
+  public:
+    using TaskFn = void (*)(void *ctx, int taskIndex);
+    static constexpr int maxTasks = 64; // per run
+
+    RenderPool() = default;
+    RenderPool(const RenderPool &) = delete;
+    RenderPool &operator=(const RenderPool &) = delete;
+    ~RenderPool() { stop(); }
+
+    /*
+     * The process' pool, started with `workers` workers by whoever asks first. Main thread.
+     */
+    static std::shared_ptr<RenderPool> acquireShared(int workers);
+
+    // Main thread. Starting a running pool restarts it with the new worker count.
+    void start(int workers);
+    void stop();
+    bool isRunning() const { return !threads.empty(); }
+    int workerCount() const { return (int)threads.size(); }
+
+    /*
+     * Run fn(ctx, i) for i in 0...nTasks-1 across the workers and the calling thread,
+     * returning once they are all done. Returns false (having run nothing) if the pool
+     * isn't running, another thread is running on it, or nTasks is out of range, in which
+     * case the caller should do the work.
+     */
+    bool run(int nTasks, TaskFn fn, void *ctx);
+
+  private:
+    struct alignas(64) Deque
+    {
+        static constexpr int64_t mask = maxTasks - 1;
+
+        // Indices only ever grow, so a stale thief can never mistake one task for another
+        std::atomic<int64_t> top{0}, bottom{0};
+        int tasks[maxTasks];
+
+        void push(int task); // only between runs
+        bool pop(int &task); // owner
+        enum StealResult
+        {
+            EMPTY,
+            LOST_RACE,
+            STOLEN
+        };
+        StealResult steal(int &task); // anyone
+    };
+
+    void workerLoop(int participant, uint32_t seenGeneration);
+    void work(int participant);
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Deque[]> deques; // index 0 is the caller of run, 1... the workers
+
+    TaskFn taskFn{nullptr};
+    void *taskCtx{nullptr};
+
+    std::atomic<uint32_t> generation{0};
+    std::atomic<int> checkedIn{0};
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> quit{false};
+    std::atomic<bool> inRun{false};
+    std::mutex parkMutex;
+    std::condition_variable parkCondition;
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_RENDER_POOL_H
@@ -8,6 +8,7 @@
  */
 
 #include "saw-voice.h"
+#include "fast-math.h"
 #include <cmath>
 #include <algorithm>
 
@@ -22,36 +23,64 @@ namespace sst::clap_saw_demo
 float pival =
     3.14159265358979323846; // I always forget what you need for M_PI to work on all platforms
 
-void SawDemoVoice::recalcPitch()
+void SawDemoVoice::recalcPitch(const Controls &c)
 {
-    baseFreq = 440.0 * pow(2.0, ((key + pitchNoteExpressionValue + pitchBendWheel +
-                                  (oscDetune + oscDetuneMod) / 100) -
-                                 69.0) /
-                                    12.0);
+    auto p = mathPrecision();
+    auto note = c.key + c.pitchNoteExpressionValue + c.pitchBendWheel +
+                (c.oscDetune + c.oscDetuneMod) / 100;
+    baseFreq = fast_math::noteToFreq(note, p);
 
     for (int i = 0; i < unison; ++i)
     {
-        dPhase[i] =
-            (baseFreq * pow(2.0, (uniSpread + uniSpreadMod) * unitShift[i] / 100.0 / 12.0)) /
-            sampleRate;
-        dPhaseInv[i] = 1.0 / dPhase[i];
+        auto cents = (c.uniSpread + c.uniSpreadMod) * c.unitShift[i];
+        lanes.dPhase[i] = (baseFreq * fast_math::exp2(cents / 1200.0, p)) / sampleRate;
+        lanes.dPhaseInv[i] = 1.0 / lanes.dPhase[i];
     }
 }
 
-void SawDemoVoice::recalcFilter()
+void SawDemoVoice::recalcFilter(const Controls &c)
 {
-    auto co = cutoff + cutoffMod;
-    auto rm = res + resMod;
+    auto co = c.cutoff + c.cutoffMod;
+    auto rm = c.res + c.resMod;
 
-    auto newfm = (StereoSimperSVF::Mode)filterMode;
+    auto newfm = (StereoSimperSVF::Mode)c.filterMode;
 
     if (newfm != filter.mode)
         filter.init();
     filter.mode = newfm;
-    filter.setCoeff(co, rm, srInv);
+    filter.setCoeff(co, rm, srInv, mathPrecision());
 }
 
-void SawDemoVoice::step()
+void SawDemoVoice::recalcLevels(const Controls &c)
+{
+    ampGate = c.ampGate;
+    ampAttack = c.ampAttack;
+    ampRelease = c.ampRelease;
+    vcaLevel = c.preFilterVCA + c.preFilterVCAMod + c.volumeNoteExpressionValue;
+}
+
+float SawDemoVoice::currentLevel() const
+{
+    float AR{0.f};
+    switch (state)
+    {
+    case ATTACK:
+        AR = ampGate ? 1.f : time / ampAttack;
+        break;
+    case HOLD:
+        AR = 1.f;
+        break;
+    case RELEASING:
+        AR = ampGate ? 1.f : releaseFrom * (1.f - time / ampRelease);
+        break;
+    case OFF:
+    case NEWLY_OFF:
+        break;
+    }
+    return AR * vcaLevel;
+}
+
+float SawDemoVoice::envelopeStep()
 {
     float AR = 1.0;
 
@@ -100,82 +129,111 @@ void SawDemoVoice::step()
             AR = 1.0;
     }
 
-    AR *= (preFilterVCA + preFilterVCAMod + volumeNoteExpressionValue);
-    L = 0;
-    R = 0;
+    return AR;
+}
 
-    for (int i = 0; i < unison; ++i)
+int SawDemoVoice::renderEnvelope(float *env, int frames)
+{
+    auto vca = vcaLevel;
+    for (int s = 0; s < frames; ++s)
     {
-        /*
-         * Use a cubic integrated saw and second derive it at
-         * each point. This is basically the math I worked
-         * out for the surge modern oscillator. The cubic function
-         * which gives a clean saw is phase^3 / 6 - phase / 6.
-         * Evaluate it at 3 points and then differentiate it like
-         * we do in Surge Modern. The waveform is the same both
-         * channels.
-         */
-        double phaseSteps[3];
-        for (int q = -2; q <= 0; ++q)
-        {
-            double ph = phase[i] + q * dPhase[i];
+        env[s] = envelopeStep() * vca;
+        if (state == NEWLY_OFF)
+            return s + 1;
+    }
+    return frames;
+}
 
-            // Bind phase to 0...1. Lots of ways to do this
-            ph = ph - floor(ph);
+int SawDemoVoice::renderUnfiltered(float *L, float *R, int frames)
+{
+    alignas(16) float env[blockSize];
 
-            // Our calculation assumes phase in -1,1 and this phase is
-            // in 0 1 so
-            ph = ph * 2 - 1;
-            phaseSteps[q + 2] = (ph * ph - 1) * ph / 6.0;
-        }
-        // the 0.25 here is because of the phase rescaling again
-        double saw = (phaseSteps[0] + phaseSteps[2] - 2 * phaseSteps[1]) * 0.25 * dPhaseInv[i] *
-                     dPhaseInv[i];
+    auto n = renderEnvelope(env, std::min(frames, blockSize));
 
-        L += 0.2 * norm[i] * AR * panL[i] * saw;
-        R += 0.2 * norm[i] * AR * panR[i] * saw;
+    /*
+     * Use a cubic integrated saw and second derive it at each point. This is basically the
+     * math I worked out for the surge modern oscillator. The cubic function which gives a
+     * clean saw is phase^3 / 6 - phase / 6. Evaluate it at 3 points and then differentiate
+     * it like we do in Surge Modern. The SIMD unison kernel (unison-saw-kernel.h) does that
+     * for every unison voice across the block. The envelope is common to all unison voices
+     * so we apply it afterwards.
+     */
+    unison_kernel::render(lanes, L, R, n);
 
-        phase[i] += dPhase[i];
-        if (phase[i] > 1)
-            phase[i] -= 1;
+    for (int s = 0; s < n; ++s)
+    {
+        L[s] *= env[s];
+        R[s] *= env[s];
     }
+    return n;
+}
 
-    filter.step(L, R);
+void SawDemoVoice::trackSilence(const float *L, const float *R, int frames)
+{
+    if (state != RELEASING)
+    {
+        quietFrames = 0;
+        return;
+    }
+
+    float peak{0.f};
+    for (int s = 0; s < frames; ++s)
+        peak = std::max({peak, std::fabs(L[s]), std::fabs(R[s])});
+
+    if (peak >= silenceThreshold)
+    {
+        quietFrames = 0;
+        return;
+    }
+    quietFrames += frames;
+    if (quietFrames >= silenceSeconds * sampleRate)
+        state = NEWLY_OFF;
 }
 
-void SawDemoVoice::start(int key)
+void SawDemoVoice::start(Controls &c)
 {
     srInv = 1.0 / sampleRate;
+    quietFrames = 0;
 
     filter.init();
-    this->key = key;
+    unison = std::clamp(c.unison, 1, max_uni);
+    recalcLevels(c);
     state = (ampAttack > 0 ? ATTACK : HOLD);
     time = 0;
+    endedAt = -1;
 
     if (unison == 1)
     {
-        unitShift[0] = 0;
-        panL[0] = 1;
-        panR[0] = 1;
-        phase[0] = 0.0;
-        norm[0] = 1.0;
+        c.unitShift[0] = 0;
+        c.panL[0] = 1;
+        c.panR[0] = 1;
+        lanes.phase[0] = 0.0;
+        c.norm[0] = 1.0;
     }
     else
     {
         for (int i = 0; i < unison; ++i)
         {
             float dI = 1.0 * i / (unison - 1);
-            unitShift[i] = 2 * dI - 1;
-            phase[i] = dI;
-            panL[i] = std::cos(0.5 * pival * dI);
-            panR[i] = std::sin(0.5 * pival * dI);
+            c.unitShift[i] = 2 * dI - 1;
+            lanes.phase[i] = dI;
+            c.panL[i] = std::cos(0.5 * pival * dI);
+            c.panR[i] = std::sin(0.5 * pival * dI);
 
-            norm[i] = 1.0 / sqrt(unison);
+            c.norm[i] = 1.0 / sqrt(unison);
         }
     }
 
-    recalcPitch();
-    recalcFilter();
+    lanes.count = unison;
+    for (int i = 0; i < unison; ++i)
+    {
+        lanes.gainL[i] = 0.2 * c.norm[i] * c.panL[i];
+        lanes.gainR[i] = 0.2 * c.norm[i] * c.panR[i];
+    }
+    lanes.padUnusedLanes();
+
+    recalcPitch(c);
+    recalcFilter(c);
 }
 
 void SawDemoVoice::release()
@@ -187,12 +245,13 @@ void SawDemoVoice::release()
         state = NEWLY_OFF;
 }
 
-void SawDemoVoice::StereoSimperSVF::setCoeff(float key, float res, float srInv)
+void SawDemoVoice::StereoSimperSVF::setCoeff(float key, float res, float srInv,
+                                             fast_math::Precision p)
 {
-    auto co = 440.0 * pow(2.0, (key - 69.0) / 12);
+    auto co = fast_math::noteToFreq(key, p);
     co = std::clamp(co, 10.0, 15000.0); // just to be safe/lazy
     res = std::clamp(res, 0.01f, 0.99f);
-    g = std::tan(pival * co * srInv);
+    g = fast_math::tanPrewarp(co * srInv, p);
     k = 2.0 - 2.0 * res;
     gk = g + k;
     a1 = 1.0 / (1.0 + g * gk);
@@ -201,49 +260,6 @@ void SawDemoVoice::StereoSimperSVF::setCoeff(float key, float res, float srInv)
     ak = gk * a1;
 }
 
-void SawDemoVoice::StereoSimperSVF::step(float &L, float &R)
-{
-    float vin[2]{L, R};
-    float res[2]{0, 0};
-    for (int c = 0; c < 2; ++c)
-    {
-        auto v3 = vin[c] - ic2eq[c];
-        auto v0 = a1 * v3 - ak * ic1eq[c];
-        auto v1 = a2 * v3 + a1 * ic1eq[c];
-        auto v2 = a3 * v3 + a2 * ic1eq[c] + ic2eq[c];
-
-        ic1eq[c] = 2 * v1 - ic1eq[c];
-        ic2eq[c] = 2 * v2 - ic2eq[c];
-
-        // I know that a branch in this loop is inefficient and so on
-        // remember this is mostly showing you how it hangs together.
-        switch (mode)
-        {
-        case LP:
-            res[c] = v2;
-            break;
-        case BP:
-            res[c] = v1;
-            break;
-        case HP:
-            res[c] = v0;
-            break;
-        case NOTCH:
-            res[c] = v2 + v0; // low + high
-            break;
-        case PEAK:
-            res[c] = v2 - v0; // low - high;
-            break;
-        case ALL:
-            res[c] = v2 + v0 - k * v1; // low + high - k * band
-            break;
-        }
-    }
-
-    L = res[0];
-    R = res[1];
-}
-
 void SawDemoVoice::StereoSimperSVF::init()
 {
     for (int c = 0; c < 2; ++c)
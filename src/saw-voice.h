@@ -12,6 +12,8 @@
 
 #include <array>
 #include "debug-helpers.h"
+#include "unison-saw-kernel.h"
+#include "fast-math.h"
 
 namespace sst::clap_saw_demo
 {
@@ -32,51 +34,73 @@ namespace sst::clap_saw_demo
  * polyphonic and note expression modulation of the pre-filter VCA
  * without the internal AEG getting in the way.
  *
- * The API is pretty direct, exposing members which you can just write
- * to from the Audio thread.
+ * The voice is split into 'hot' and 'cold' halves. SawDemoVoice itself is the hot half:
+ * the oscillator, envelope and filter state which the render loop touches every sample.
+ * SawDemoVoice::Controls is the cold half: which note the voice is playing and the base and
+ * modulation values of each parameter, which only the event handlers touch. The engine keeps
+ * the two in separate arrays (see voice-pool.h) so a render pass over the playing voices never
+ * pulls the routing and modulation data through the cache. Write to the Controls, then call
+ * the matching recalc function to fold them into the hot state.
  */
 struct SawDemoVoice
 {
     static constexpr int max_uni = 7;
 
-    int portid;  // clap note port index
-    int channel; // midi channel
-    int key;     // The midi key which triggered me
-    int note_id; // and the note_id delivered by the host (used for note expressions)
+    // renderUnfiltered, and so VoiceQuad, renders at most this many samples at a time
+    static constexpr int blockSize = 64;
 
-    // unison count is snapped at voice on
-    int unison{3};
-
-    // Note the pattern that we have an item and its modulator as the API
-    float uniSpread{10.0}, uniSpreadMod{0.0};
-
-    // The oscillator detuning
-    float oscDetune{0}, oscDetuneMod{0};
-
-    // Filter characteristics. After adjusting these call 'recalcFilter'.
-    int filterMode{StereoSimperSVF::Mode::LP};
-    float cutoff{69.0}, res{0.7};
-    float cutoffMod{0.0}, resMod{0.0};
-
-    // The internal AEG is incredibly simple. Bypass or not, and have
-    // an attack and release time in seconds. These aren't modulatable
-    // mostly out of laziness.
-    bool ampGate{false};
-    float ampAttack{0.01}, ampRelease{0.1};
-
-    // The pre-filter VCA is unique in that it can be either internally
-    // modulated and externally modulated. If ampGate is false, the internal
-    // modulation is bypassed. The two vectors for modulation are a VCAMod
-    // value, intended for param modulation, and a volumeNoteExpressionValue
-    float preFilterVCA{1.0}, preFilterVCAMod{0.0}, volumeNoteExpressionValue{0.f};
-
-    // Two values can modify pitch, the note expression and the bend wheel.
-    // After adjusting these, call 'recalcPitch'
-    float pitchNoteExpressionValue{0.f}, pitchBendWheel{0.f};
+    struct Controls
+    {
+        int portid{0};    // clap note port index
+        int channel{0};   // midi channel
+        int key{0};       // The midi key which triggered me
+        int note_id{-1};  // and the note_id delivered by the host (used for note expressions)
+
+        // unison count is snapped at voice on
+        int unison{3};
+
+        // The unison layout, which start fills in from unison: each unison voice's place in
+        // the detune spread, its pan and its level. It only changes at voice on, so it lives
+        // here with the cold data rather than in the voice the render walks.
+        std::array<float, max_uni> unitShift{}, panL{}, panR{}, norm{};
+
+        // Note the pattern that we have an item and its modulator as the API.
+        // After adjusting the oscillator values call 'recalcPitch'.
+        float uniSpread{10.0}, uniSpreadMod{0.0};
+
+        // The oscillator detuning
+        float oscDetune{0}, oscDetuneMod{0};
+
+        // Filter characteristics (filterMode is a StereoSimperSVF::Mode).
+        // After adjusting these call 'recalcFilter'.
+        int filterMode{0};
+        float cutoff{69.0}, res{0.7};
+        float cutoffMod{0.0}, resMod{0.0};
+
+        // The internal AEG is incredibly simple. Bypass or not, and have
+        // an attack and release time in seconds. These aren't modulatable
+        // mostly out of laziness. After adjusting these, call 'recalcLevels'
+        bool ampGate{false};
+        float ampAttack{0.01}, ampRelease{0.1};
+
+        // The pre-filter VCA is unique in that it can be either internally
+        // modulated and externally modulated. If ampGate is false, the internal
+        // modulation is bypassed. The two vectors for modulation are a VCAMod
+        // value, intended for param modulation, and a volumeNoteExpressionValue.
+        // After adjusting these, call 'recalcLevels'
+        float preFilterVCA{1.0}, preFilterVCAMod{0.0}, volumeNoteExpressionValue{0.f};
+
+        // Two values can modify pitch, the note expression and the bend wheel.
+        // After adjusting these, call 'recalcPitch'
+        float pitchNoteExpressionValue{0.f}, pitchBendWheel{0.f};
+    };
 
     // Finally, please set my sample rate at voice on. Thanks!
     float sampleRate{0};
 
+    // Use the exact fast_math functions whatever the global precision (see fast-math.h)
+    bool exactMath{false};
+
     // What is my AEG state. This will advance across attack hold releasing NEWLY_OFF
     // even if the AEG is bypassed. NEWLY_OFF is a state which lets us detect voices which
     // terminate in a block so we can inform the DAW with a CLAP_EVENT_NOTE_END for polyphonic
@@ -90,21 +114,45 @@ struct SawDemoVoice
         RELEASING
     } state{OFF};
 
-    // L / R are the output.
-    float L{0.f}, R{0.f};
+    // The frame a voice which reached NEWLY_OFF while rendering made its last sample at, or -1
+    // while it plays. VoiceQuad::render sets it relative to the frames it rendered and the
+    // engine moves it to the frame in its block, so the CLAP_EVENT_NOTE_END lands there.
+    int endedAt{-1};
 
-    // start, then step the voice forever. release it on note off. sometime after that
+    // start, then render the voice forever. release it on note off. sometime after that
     // the voice will transition to NEWLY_OFF which you should detect then externally
-    // move it to OFF
-    void start(int key);
-    void step();
+    // move it to OFF. start also fills in the unison layout in c.
+    void start(Controls &c);
     void release();
 
-    void recalcPitch();
-    void recalcFilter();
+    /*
+     * renderUnfiltered renders the envelope and oscillator, but not the filter, for at most
+     * blockSize frames. It *overwrites* L and R and returns how many
+     * samples the voice was alive for, leaving the rest of L and R untouched. VoiceQuad uses
+     * it to filter several voices at once.
+     */
+    int renderUnfiltered(float *L, float *R, int frames);
+
+    /*
+     * A releasing voice whose output stays below silenceThreshold for silenceSeconds has
+     * faded out in all but name, but with a long release would still run its oscillator and
+     * filter for seconds. trackSilence looks at each block the voice renders, L and R after
+     * the filter, and once it has been quiet long enough moves the voice to NEWLY_OFF, just as
+     * the end of the release would.
+     */
+    static constexpr float silenceThreshold = 3.16e-5f; // -90dBFS
+    static constexpr float silenceSeconds = 0.02f;
+    void trackSilence(const float *L, const float *R, int frames);
+
+    void recalcPitch(const Controls &c);
+    void recalcFilter(const Controls &c);
+    void recalcLevels(const Controls &c);
 
     inline bool isPlaying() const { return state != OFF && state != NEWLY_OFF; }
 
+    // The envelope times VCA level the voice is sounding at, without advancing anything
+    float currentLevel() const;
+
     struct StereoSimperSVF // thanks to urs @ u-he and andy simper @ cytomic
     {
         float ic1eq[2]{0.f, 0.f}, ic2eq[2]{0.f, 0.f};
@@ -119,20 +167,36 @@ struct SawDemoVoice
             ALL
         } mode{LP};
 
-        float low[2], band[2], high[2], notch[2], peak[2], all[2];
-        void setCoeff(float key, float res, float srInv);
-        void step(float &L, float &R);
+        void setCoeff(float key, float res, float srInv, fast_math::Precision p);
         void init();
     } filter;
 
   private:
+    // Hot copies of the envelope controls and the summed VCA level, set by recalcLevels
+    int unison{3};
+    bool ampGate{false};
+    float ampAttack{0.01}, ampRelease{0.1};
+    float vcaLevel{1.0};
+
+    // Fill env with the AR * VCA level for up to frames samples, advancing the
+    // envelope state. Returns the number of samples the voice is alive for.
+    int renderEnvelope(float *env, int frames);
+    float envelopeStep();
+
+    fast_math::Precision mathPrecision() const
+    {
+        return exactMath ? fast_math::Precision::Exact : fast_math::activePrecision();
+    }
+
     double baseFreq{440.0};
     double srInv{1.0 / 44100.0};
     float time{0}, filterTime{0};
     float releaseFrom{1.0};
+    int quietFrames{0}; // for trackSilence
 
-    std::array<float, max_uni> panL, panR, unitShift, norm;
-    std::array<double, max_uni> phase, dPhase, dPhaseInv;
+    // phase, dPhase, dPhaseInv and the per-unison gains live in SIMD friendly lanes
+    // which the unison kernel consumes directly
+    unison_kernel::UnisonLanes lanes;
 };
 } // namespace sst::clap_saw_demo
 #endif
@@ -0,0 +1,106 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_SIMD_F4_H
+#define CLAP_SAW_DEMO_SIMD_F4_H
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSD_F4_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define CSD_F4_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace sst::clap_saw_demo
+{
+/*
+ * Just enough of a four-float vector to write the voice quad filter and the decimator once.
+ * On platforms without SSE or NEON (emscripten) this is a plain array the compiler can do
+ * what it likes with.
+ */
+#if CSD_F4_SSE
+typedef __m128 f4_t;
+inline f4_t f4Load(const float *p) { return _mm_load_ps(p); }
+inline f4_t f4LoadU(const float *p) { return _mm_loadu_ps(p); }
+inline void f4Store(float *p, f4_t a) { _mm_store_ps(p, a); }
+inline void f4StoreU(float *p, f4_t a) { _mm_storeu_ps(p, a); }
+inline f4_t f4Set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+inline f4_t f4Set1(float a) { return _mm_set1_ps(a); }
+inline f4_t f4Add(f4_t a, f4_t b) { return _mm_add_ps(a, b); }
+inline f4_t f4Sub(f4_t a, f4_t b) { return _mm_sub_ps(a, b); }
+inline f4_t f4Mul(f4_t a, f4_t b) { return _mm_mul_ps(a, b); }
+inline void f4Transpose(f4_t &r0, f4_t &r1, f4_t &r2, f4_t &r3)
+{
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+}
+#elif CSD_F4_NEON
+typedef float32x4_t f4_t;
+inline f4_t f4Load(const float *p) { return vld1q_f32(p); }
+inline f4_t f4LoadU(const float *p) { return vld1q_f32(p); }
+inline void f4Store(float *p, f4_t a) { vst1q_f32(p, a); }
+inline void f4StoreU(float *p, f4_t a) { vst1q_f32(p, a); }
+inline f4_t f4Set(float a, float b, float c, float d)
+{
+    float t[4]{a, b, c, d};
+    return vld1q_f32(t);
+}
+inline f4_t f4Set1(float a) { return vdupq_n_f32(a); }
+inline f4_t f4Add(f4_t a, f4_t b) { return vaddq_f32(a, b); }
+inline f4_t f4Sub(f4_t a, f4_t b) { return vsubq_f32(a, b); }
+inline f4_t f4Mul(f4_t a, f4_t b) { return vmulq_f32(a, b); }
+inline void f4Transpose(f4_t &r0, f4_t &r1, f4_t &r2, f4_t &r3)
+{
+    auto t01 = vtrnq_f32(r0, r1);
+    auto t23 = vtrnq_f32(r2, r3);
+    r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+#else
+struct f4_t
+{
+    float v[4];
+};
+inline f4_t f4Load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline f4_t f4LoadU(const float *p) { return f4Load(p); }
+inline void f4Store(float *p, f4_t a) { memcpy(p, a.v, sizeof(a.v)); }
+inline void f4StoreU(float *p, f4_t a) { f4Store(p, a); }
+inline f4_t f4Set(float a, float b, float c, float d) { return {{a, b, c, d}}; }
+inline f4_t f4Set1(float a) { return {{a, a, a, a}}; }
+inline f4_t f4Add(f4_t a, f4_t b)
+{
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+inline f4_t f4Sub(f4_t a, f4_t b)
+{
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+}
+inline f4_t f4Mul(f4_t a, f4_t b)
+{
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+inline void f4Transpose(f4_t &r0, f4_t &r1, f4_t &r2, f4_t &r3)
+{
+    f4_t i[4]{r0, r1, r2, r3}, o[4];
+    for (int r = 0; r < 4; ++r)
+        for (int c = 0; c < 4; ++c)
+            o[c].v[r] = i[r].v[c];
+    r0 = o[0];
+    r1 = o[1];
+    r2 = o[2];
+    r3 = o[3];
+}
+#endif
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_SIMD_F4_H
@@ -0,0 +1,159 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_STATE_STREAM_H
+#define CLAP_SAW_DEMO_STATE_STREAM_H
+
+/*
+ * StateWriter and StateReader put a small fixed buffer between the state code and the host's
+ * clap_ostream / clap_istream, so a save or load is a handful of stream calls rather than one
+ * per value, nothing is allocated, and there is no limit on the size of what we read beyond
+ * what the caller asks for. The host is allowed to take or give fewer bytes than we ask for on
+ * any call, so both sides loop until they have what they need or the stream reports an error
+ * or the end.
+ *
+ * Numbers are written little endian whatever the machine, and doubles as their bit pattern so
+ * a value round trips exactly.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <clap/clap.h>
+
+namespace sst::clap_saw_demo
+{
+static constexpr size_t stateChunkSize = 256;
+
+class StateWriter
+{
+  public:
+    explicit StateWriter(const clap_ostream *s) : stream(s) {}
+
+    void bytes(const void *data, size_t n)
+    {
+        auto *d = static_cast<const uint8_t *>(data);
+        while (n > 0 && ok)
+        {
+            auto take = std::min(n, stateChunkSize - used);
+            memcpy(buffer + used, d, take);
+            used += take;
+            d += take;
+            n -= take;
+            if (used == stateChunkSize)
+                flush();
+        }
+    }
+    void u32(uint32_t v)
+    {
+        uint8_t b[4];
+        for (int i = 0; i < 4; ++i)
+            b[i] = (uint8_t)(v >> (8 * i));
+        bytes(b, 4);
+    }
+    void f64(double v)
+    {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        uint8_t b[8];
+        for (int i = 0; i < 8; ++i)
+            b[i] = (uint8_t)(bits >> (8 * i));
+        bytes(b, 8);
+    }
+
+    // Write out whatever is buffered. False if the host refused any of the writes.
+    bool finish()
+    {
+        flush();
+        return ok;
+    }
+
+  private:
+    void flush()
+    {
+        size_t done = 0;
+        while (ok && done < used)
+        {
+            auto r = stream->write(stream, buffer + done, used - done);
+            if (r <= 0)
+                ok = false;
+            else
+                done += (size_t)r;
+        }
+        used = 0;
+    }
+
+    const clap_ostream *stream;
+    uint8_t buffer[stateChunkSize];
+    size_t used{0};
+    bool ok{true};
+};
+
+class StateReader
+{
+  public:
+    explicit StateReader(const clap_istream *s) : stream(s) {}
+
+    // All or nothing: false if the stream ends or fails before n bytes arrive
+    bool bytes(void *data, size_t n)
+    {
+        auto *d = static_cast<uint8_t *>(data);
+        while (n > 0)
+        {
+            if (pos == size && !fill())
+                return false;
+            auto take = std::min(n, size - pos);
+            memcpy(d, buffer + pos, take);
+            pos += take;
+            d += take;
+            n -= take;
+        }
+        return true;
+    }
+    bool u32(uint32_t &v)
+    {
+        uint8_t b[4];
+        if (!bytes(b, 4))
+            return false;
+        v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t)b[i] << (8 * i);
+        return true;
+    }
+    bool f64(double &v)
+    {
+        uint8_t b[8];
+        if (!bytes(b, 8))
+            return false;
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i)
+            bits |= (uint64_t)b[i] << (8 * i);
+        memcpy(&v, &bits, sizeof(v));
+        return true;
+    }
+    bool byte(char &c) { return bytes(&c, 1); }
+
+  private:
+    bool fill()
+    {
+        auto r = stream->read(stream, buffer, stateChunkSize);
+        if (r <= 0)
+            return false;
+        pos = 0;
+        size = (size_t)r;
+        return true;
+    }
+
+    const clap_istream *stream;
+    uint8_t buffer[stateChunkSize];
+    size_t pos{0}, size{0};
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_STATE_STREAM_H
@@ -0,0 +1,180 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_UI_CHANNEL_H
+#define CLAP_SAW_DEMO_UI_CHANNEL_H
+
+/*
+ * A UIChannel carries messages one way between the engine and the editor. It has two halves,
+ * because the two kinds of thing we send want different guarantees.
+ *
+ * Parameter values go through a ParamMailbox. Only the newest value of a parameter matters to
+ * whoever reads it, so rather than queueing every change the mailbox keeps one value per
+ * parameter and a dirty bit, and the reader sweeps the dirty bits and takes the current value
+ * of each. Automating every knob at once costs the reader one pass over a handful of words
+ * however many changes arrived, and since writing never fails the final value can't be lost
+ * to a full queue the way it could before. Any thread may write; one thread reads.
+ *
+ * Since a mailbox always holds the latest value of everything it has been given, the engine
+ * also keeps one as a mirror of its own parameters (ClapSawDemo::paramMirror) which the main
+ * thread can read at any time, and whose dirty bits the editor sweeps.
+ *
+ * Everything whose order or count matters, like gestures and notes, goes through a
+ * MessageRing: a single producer, single consumer ring of variable length records, each a
+ * small header and a payload, so a sender can put a whole block's worth of something in one
+ * record. A push which doesn't fit fails as a whole and the caller decides what to do.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace sst::clap_saw_demo
+{
+template <int N> class ParamMailbox
+{
+  public:
+    void set(int index, double value)
+    {
+        values[index].store(value, std::memory_order_relaxed);
+        dirty[index / 64].fetch_or(1ULL << (index % 64), std::memory_order_release);
+    }
+
+    // Update a value without flagging it, for a change which came from the reader itself
+    void store(int index, double value) { values[index].store(value, std::memory_order_relaxed); }
+
+    // Flag everything, so the next drain sees every value
+    void markAll()
+    {
+        for (int i = 0; i < N; ++i)
+            dirty[i / 64].fetch_or(1ULL << (i % 64), std::memory_order_release);
+    }
+
+    double get(int index) const { return values[index].load(std::memory_order_relaxed); }
+
+    // Reader: call f(index, value) once for each parameter set since the last drain
+    template <typename F> void drain(F &&f)
+    {
+        for (int w = 0; w < nWords; ++w)
+        {
+            if (!dirty[w].load(std::memory_order_relaxed))
+                continue;
+            auto bits = dirty[w].exchange(0, std::memory_order_acquire);
+            while (bits)
+            {
+                auto b = lowestBit(bits);
+                bits &= bits - 1;
+                auto index = w * 64 + b;
+                f(index, values[index].load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+  private:
+    static int lowestBit(uint64_t bits)
+    {
+        int b = 0;
+        while (!(bits & 1))
+        {
+            bits >>= 1;
+            ++b;
+        }
+        return b;
+    }
+
+    static constexpr int nWords = (N + 63) / 64;
+    std::atomic<uint64_t> dirty[nWords]{};
+    std::atomic<double> values[N]{};
+};
+
+template <uint32_t Capacity> class MessageRing
+{
+    static_assert(Capacity >= 64 && (Capacity & (Capacity - 1)) == 0,
+                  "The ring size must be a power of two");
+
+  public:
+    static constexpr uint32_t maxPayload = 1024;
+
+    // Producer: false, and nothing written, if the record doesn't fit
+    bool push(uint16_t type, const void *payload, uint16_t size)
+    {
+        if (size > maxPayload)
+            return false;
+        auto w = head.load(std::memory_order_relaxed);
+        auto r = tail.load(std::memory_order_acquire);
+        auto total = recordSize(size);
+        if (Capacity - (w - r) < total)
+            return false;
+
+        uint8_t hdr[headerSize];
+        memcpy(hdr, &type, 2);
+        memcpy(hdr + 2, &size, 2);
+        copyIn(w, hdr, headerSize);
+        if (size)
+            copyIn(w + headerSize, payload, size);
+        head.store(w + total, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: call f(type, payload, size) for each record waiting, in order
+    template <typename F> void drain(F &&f)
+    {
+        auto r = tail.load(std::memory_order_relaxed);
+        auto w = head.load(std::memory_order_acquire);
+        while (r != w)
+        {
+            uint8_t hdr[headerSize];
+            copyOut(r, hdr, headerSize);
+            uint16_t type, size;
+            memcpy(&type, hdr, 2);
+            memcpy(&size, hdr + 2, 2);
+            copyOut(r + headerSize, scratch, size);
+            r += recordSize(size);
+
+            // Hand the space back before the callback, which may well push to another ring
+            tail.store(r, std::memory_order_release);
+            f(type, (const void *)scratch, size);
+        }
+    }
+
+  private:
+    static constexpr uint32_t headerSize = 4;
+
+    // Records are padded to 4 bytes, so a header never straddles the end of the buffer
+    static uint32_t recordSize(uint16_t size) { return (headerSize + size + 3) & ~3U; }
+
+    void copyIn(uint32_t at, const void *src, uint32_t n)
+    {
+        auto pos = at & (Capacity - 1);
+        auto first = n < Capacity - pos ? n : Capacity - pos;
+        memcpy(buffer + pos, src, first);
+        memcpy(buffer, (const uint8_t *)src + first, n - first);
+    }
+    void copyOut(uint32_t at, void *dst, uint32_t n) const
+    {
+        auto pos = at & (Capacity - 1);
+        auto first = n < Capacity - pos ? n : Capacity - pos;
+        memcpy(dst, buffer + pos, first);
+        memcpy((uint8_t *)dst + first, buffer, n - first);
+    }
+
+    uint8_t buffer[Capacity];
+    uint8_t scratch[maxPayload];
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+};
+
+template <int NParams, uint32_t RingBytes> struct UIChannel
+{
+    ParamMailbox<NParams> params;
+    MessageRing<RingBytes> messages;
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_UI_CHANNEL_H
@@ -0,0 +1,395 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#include "unison-saw-kernel.h"
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSD_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CSD_TARGET_AVX
+#else
+#define CSD_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define CSD_KERNEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+ * Every implementation here does exactly what the scalar reference does, per lane, per
+ * sample:
+ *
+ *   for q in -2, -1, 0
+ *       ph = phase + q * dPhase, wrapped to 0..1 then rescaled to -1..1
+ *       c[q] = (ph * ph - 1) * ph / 6
+ *   saw = (c[-2] + c[0] - 2 c[-1]) * 0.25 / dPhase^2
+ *   L += gainL * saw, R += gainR * saw
+ *   phase += dPhase, and wrap by subtracting 1 if above 1
+ *
+ * The only difference is the vector versions multiply by 1/6 rather than divide, which
+ * moves the result by an ulp or so.
+ */
+
+namespace sst::clap_saw_demo::unison_kernel
+{
+void UnisonLanes::padUnusedLanes()
+{
+    for (int i = count; i < maxLanes; ++i)
+    {
+        phase[i] = 0.0;
+        dPhase[i] = 0.5;
+        dPhaseInv[i] = 2.0;
+        gainL[i] = 0.0;
+        gainR[i] = 0.0;
+    }
+}
+
+void renderScalar(UnisonLanes &lanes, float *L, float *R, int frames)
+{
+    for (int s = 0; s < frames; ++s)
+    {
+        L[s] = 0.f;
+        R[s] = 0.f;
+    }
+
+    for (int i = 0; i < lanes.count; ++i)
+    {
+        auto dp = lanes.dPhase[i];
+        auto dpi2 = 0.25 * lanes.dPhaseInv[i] * lanes.dPhaseInv[i];
+        auto gL = lanes.gainL[i], gR = lanes.gainR[i];
+        auto ph0 = lanes.phase[i];
+
+        for (int s = 0; s < frames; ++s)
+        {
+            double phaseSteps[3];
+            for (int q = -2; q <= 0; ++q)
+            {
+                double ph = ph0 + q * dp;
+                ph = ph - std::floor(ph);
+                ph = ph * 2 - 1;
+                phaseSteps[q + 2] = (ph * ph - 1) * ph / 6.0;
+            }
+            double saw = (phaseSteps[0] + phaseSteps[2] - 2 * phaseSteps[1]) * dpi2;
+
+            L[s] += gL * saw;
+            R[s] += gR * saw;
+
+            ph0 += dp;
+            if (ph0 > 1)
+                ph0 -= 1;
+        }
+        lanes.phase[i] = ph0;
+    }
+}
+
+#if CSD_KERNEL_X86
+namespace
+{
+// SSE2 has no floor for doubles. Our phases are within (-2, 1] so truncating through
+// int32 and correcting negative non-integers is exact.
+inline __m128d floorSSE2(__m128d x)
+{
+    auto t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+    return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, x), _mm_set1_pd(1.0)));
+}
+
+inline __m128d cubicSSE2(__m128d ph)
+{
+    const auto one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0);
+    const auto sixth = _mm_set1_pd(1.0 / 6.0);
+    ph = _mm_sub_pd(ph, floorSSE2(ph));
+    ph = _mm_sub_pd(_mm_mul_pd(ph, two), one);
+    return _mm_mul_pd(_mm_mul_pd(_mm_sub_pd(_mm_mul_pd(ph, ph), one), ph), sixth);
+}
+
+inline float hsumSSE2(__m128d v)
+{
+    return (float)_mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+CSD_TARGET_AVX inline __m256d cubicAVX(__m256d ph)
+{
+    const auto one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0);
+    const auto sixth = _mm256_set1_pd(1.0 / 6.0);
+    ph = _mm256_sub_pd(ph, _mm256_floor_pd(ph));
+    ph = _mm256_sub_pd(_mm256_mul_pd(ph, two), one);
+    return _mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(ph, ph), one), ph), sixth);
+}
+} // namespace
+
+void renderSSE2(UnisonLanes &lanes, float *L, float *R, int frames)
+{
+    constexpr int W = 2;
+    const int nv = (lanes.count + W - 1) / W;
+
+    __m128d ph[maxLanes / W], dp[maxLanes / W], dpi2[maxLanes / W], gL[maxLanes / W],
+        gR[maxLanes / W];
+    for (int v = 0; v < nv; ++v)
+    {
+        ph[v] = _mm_load_pd(lanes.phase + v * W);
+        dp[v] = _mm_load_pd(lanes.dPhase + v * W);
+        auto inv = _mm_load_pd(lanes.dPhaseInv + v * W);
+        dpi2[v] = _mm_mul_pd(_mm_set1_pd(0.25), _mm_mul_pd(inv, inv));
+        gL[v] = _mm_load_pd(lanes.gainL + v * W);
+        gR[v] = _mm_load_pd(lanes.gainR + v * W);
+    }
+
+    const auto one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0);
+    for (int s = 0; s < frames; ++s)
+    {
+        auto accL = _mm_setzero_pd(), accR = _mm_setzero_pd();
+        for (int v = 0; v < nv; ++v)
+        {
+            auto c0 = cubicSSE2(_mm_sub_pd(ph[v], _mm_mul_pd(two, dp[v])));
+            auto c1 = cubicSSE2(_mm_sub_pd(ph[v], dp[v]));
+            auto c2 = cubicSSE2(ph[v]);
+            auto saw = _mm_mul_pd(_mm_sub_pd(_mm_add_pd(c0, c2), _mm_mul_pd(two, c1)), dpi2[v]);
+            accL = _mm_add_pd(accL, _mm_mul_pd(gL[v], saw));
+            accR = _mm_add_pd(accR, _mm_mul_pd(gR[v], saw));
+
+            auto np = _mm_add_pd(ph[v], dp[v]);
+            ph[v] = _mm_sub_pd(np, _mm_and_pd(_mm_cmpgt_pd(np, one), one));
+        }
+        L[s] = hsumSSE2(accL);
+        R[s] = hsumSSE2(accR);
+    }
+
+    for (int v = 0; v < nv; ++v)
+        _mm_store_pd(lanes.phase + v * W, ph[v]);
+}
+
+CSD_TARGET_AVX void renderAVX(UnisonLanes &lanes, float *L, float *R, int frames)
+{
+    constexpr int W = 4;
+    const int nv = (lanes.count + W - 1) / W;
+
+    __m256d ph[maxLanes / W], dp[maxLanes / W], dpi2[maxLanes / W], gL[maxLanes / W],
+        gR[maxLanes / W];
+    for (int v = 0; v < nv; ++v)
+    {
+        ph[v] = _mm256_load_pd(lanes.phase + v * W);
+        dp[v] = _mm256_load_pd(lanes.dPhase + v * W);
+        auto inv = _mm256_load_pd(lanes.dPhaseInv + v * W);
+        dpi2[v] = _mm256_mul_pd(_mm256_set1_pd(0.25), _mm256_mul_pd(inv, inv));
+        gL[v] = _mm256_load_pd(lanes.gainL + v * W);
+        gR[v] = _mm256_load_pd(lanes.gainR + v * W);
+    }
+
+    const auto one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0);
+
+    for (int s = 0; s < frames; ++s)
+    {
+        auto accL = _mm256_setzero_pd(), accR = _mm256_setzero_pd();
+        for (int v = 0; v < nv; ++v)
+        {
+            auto c0 = cubicAVX(_mm256_sub_pd(ph[v], _mm256_mul_pd(two, dp[v])));
+            auto c1 = cubicAVX(_mm256_sub_pd(ph[v], dp[v]));
+            auto c2 = cubicAVX(ph[v]);
+            auto saw = _mm256_mul_pd(_mm256_sub_pd(_mm256_add_pd(c0, c2), _mm256_mul_pd(two, c1)),
+                                     dpi2[v]);
+            accL = _mm256_add_pd(accL, _mm256_mul_pd(gL[v], saw));
+            accR = _mm256_add_pd(accR, _mm256_mul_pd(gR[v], saw));
+
+            auto np = _mm256_add_pd(ph[v], dp[v]);
+            ph[v] = _mm256_sub_pd(np, _mm256_and_pd(_mm256_cmp_pd(np, one, _CMP_GT_OQ), one));
+        }
+        // Fold the two stereo accumulators into one horizontal sum
+        auto lo = _mm256_castpd256_pd128(accL), hi = _mm256_extractf128_pd(accL, 1);
+        auto sL = _mm_add_pd(lo, hi);
+        lo = _mm256_castpd256_pd128(accR);
+        hi = _mm256_extractf128_pd(accR, 1);
+        auto sR = _mm_add_pd(lo, hi);
+        auto lr = _mm_add_pd(_mm_unpacklo_pd(sL, sR), _mm_unpackhi_pd(sL, sR));
+        L[s] = (float)_mm_cvtsd_f64(lr);
+        R[s] = (float)_mm_cvtsd_f64(_mm_unpackhi_pd(lr, lr));
+    }
+
+    for (int v = 0; v < nv; ++v)
+        _mm256_store_pd(lanes.phase + v * W, ph[v]);
+}
+#endif
+
+#if CSD_KERNEL_NEON
+void renderNEON(UnisonLanes &lanes, float *L, float *R, int frames)
+{
+    constexpr int W = 2;
+    const int nv = (lanes.count + W - 1) / W;
+
+    float64x2_t ph[maxLanes / W], dp[maxLanes / W], dpi2[maxLanes / W], gL[maxLanes / W],
+        gR[maxLanes / W];
+    for (int v = 0; v < nv; ++v)
+    {
+        ph[v] = vld1q_f64(lanes.phase + v * W);
+        dp[v] = vld1q_f64(lanes.dPhase + v * W);
+        auto inv = vld1q_f64(lanes.dPhaseInv + v * W);
+        dpi2[v] = vmulq_f64(vdupq_n_f64(0.25), vmulq_f64(inv, inv));
+        gL[v] = vld1q_f64(lanes.gainL + v * W);
+        gR[v] = vld1q_f64(lanes.gainR + v * W);
+    }
+
+    const auto one = vdupq_n_f64(1.0), two = vdupq_n_f64(2.0), zero = vdupq_n_f64(0.0);
+    const auto sixth = vdupq_n_f64(1.0 / 6.0);
+    auto cubic = [&](float64x2_t p)
+    {
+        p = vsubq_f64(p, vrndmq_f64(p));
+        p = vsubq_f64(vmulq_f64(p, two), one);
+        return vmulq_f64(vmulq_f64(vsubq_f64(vmulq_f64(p, p), one), p), sixth);
+    };
+
+    for (int s = 0; s < frames; ++s)
+    {
+        auto accL = zero, accR = zero;
+        for (int v = 0; v < nv; ++v)
+        {
+            auto c0 = cubic(vsubq_f64(ph[v], vmulq_f64(two, dp[v])));
+            auto c1 = cubic(vsubq_f64(ph[v], dp[v]));
+            auto c2 = cubic(ph[v]);
+            auto saw = vmulq_f64(vsubq_f64(vaddq_f64(c0, c2), vmulq_f64(two, c1)), dpi2[v]);
+            accL = vaddq_f64(accL, vmulq_f64(gL[v], saw));
+            accR = vaddq_f64(accR, vmulq_f64(gR[v], saw));
+
+            auto np = vaddq_f64(ph[v], dp[v]);
+            ph[v] = vsubq_f64(np, vbslq_f64(vcgtq_f64(np, one), one, zero));
+        }
+        L[s] = (float)vaddvq_f64(accL);
+        R[s] = (float)vaddvq_f64(accR);
+    }
+
+    for (int v = 0; v < nv; ++v)
+        vst1q_f64(lanes.phase + v * W, ph[v]);
+}
+#endif
+
+namespace
+{
+bool cpuHasAVX()
+{
+#if CSD_KERNEL_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+    if (!(osxsave && avx))
+        return false;
+    // and the OS must save the YMM registers for us
+    return (_xgetbv(0) & 0x6) == 0x6;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+#else
+    return false;
+#endif
+}
+
+std::atomic<renderFn_t> activeKernel{kernelFor(detectLevel())};
+std::atomic<Level> activeKernelLevel{detectLevel()};
+} // namespace
+
+bool isLevelAvailable(Level l)
+{
+    switch (l)
+    {
+    case Level::Scalar:
+        return true;
+    case Level::SSE2:
+#if CSD_KERNEL_X86
+        return true;
+#else
+        return false;
+#endif
+    case Level::AVX:
+        return cpuHasAVX();
+    case Level::NEON:
+#if CSD_KERNEL_NEON
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+Level detectLevel()
+{
+    if (isLevelAvailable(Level::AVX))
+        return Level::AVX;
+    if (isLevelAvailable(Level::SSE2))
+        return Level::SSE2;
+    if (isLevelAvailable(Level::NEON))
+        return Level::NEON;
+    return Level::Scalar;
+}
+
+renderFn_t kernelFor(Level l)
+{
+    if (!isLevelAvailable(l))
+        return nullptr;
+
+    switch (l)
+    {
+    case Level::Scalar:
+        return renderScalar;
+#if CSD_KERNEL_X86
+    case Level::SSE2:
+        return renderSSE2;
+    case Level::AVX:
+        return renderAVX;
+#endif
+#if CSD_KERNEL_NEON
+    case Level::NEON:
+        return renderNEON;
+#endif
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+const char *levelName(Level l)
+{
+    switch (l)
+    {
+    case Level::Scalar:
+        return "scalar";
+    case Level::SSE2:
+        return "sse2";
+    case Level::AVX:
+        return "avx";
+    case Level::NEON:
+        return "neon";
+    }
+    return "unknown";
+}
+
+Level activeLevel() { return activeKernelLevel; }
+
+void selectLevel(Level l)
+{
+    auto k = kernelFor(l);
+    if (!k)
+        return;
+    activeKernel = k;
+    activeKernelLevel = l;
+}
+
+void render(UnisonLanes &lanes, float *L, float *R, int frames)
+{
+    activeKernel.load(std::memory_order_relaxed)(lanes, L, R, frames);
+}
+} // namespace sst::clap_saw_demo::unison_kernel
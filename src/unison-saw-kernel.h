@@ -0,0 +1,81 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_UNISON_SAW_KERNEL_H
+#define CLAP_SAW_DEMO_UNISON_SAW_KERNEL_H
+
+/*
+ * The unison saw kernel is the inner loop of SawDemoVoice::renderUnfiltered. Each unison
+ * voice is a 'lane' with its own phase, phase increment and stereo gain, and the kernel
+ * advances every lane across a block, evaluating the cubic integrated saw at three points
+ * per sample and summing the lanes into a stereo pair.
+ *
+ * The lanes are stored as structure-of-arrays padded to a multiple of the widest SIMD
+ * register we use, so the vector kernels can load them directly. Padding lanes have zero
+ * gain and a harmless phase increment so they compute finite values which are then
+ * discarded.
+ *
+ * We keep several implementations of the same math
+ *
+ * - Scalar, which is the reference and the fallback on platforms without SIMD (emscripten)
+ * - SSE2 (2 doubles per register) on x86
+ * - AVX (4 doubles per register) on x86, chosen at runtime if the CPU supports it
+ * - NEON (2 doubles per register) on arm64
+ *
+ * The best available one is picked once when the library loads, and `render` calls through
+ * to it. `kernelFor` lets tools run a specific level to compare against the reference.
+ */
+
+#include <cstdint>
+
+namespace sst::clap_saw_demo::unison_kernel
+{
+static constexpr int maxLanes = 8; // SawDemoVoice::max_uni rounded up to a SIMD multiple
+
+struct UnisonLanes
+{
+    alignas(32) double phase[maxLanes]{};
+    alignas(32) double dPhase[maxLanes]{};
+    alignas(32) double dPhaseInv[maxLanes]{};
+    alignas(32) double gainL[maxLanes]{};
+    alignas(32) double gainR[maxLanes]{};
+    int count{0};
+
+    // Make lanes [count, maxLanes) silent and numerically safe
+    void padUnusedLanes();
+};
+
+enum class Level
+{
+    Scalar,
+    SSE2,
+    AVX,
+    NEON
+};
+
+/*
+ * Render `frames` samples of the summed lanes into L and R. Unlike the voice render
+ * functions this *overwrites* L and R rather than accumulating.
+ */
+typedef void (*renderFn_t)(UnisonLanes &lanes, float *L, float *R, int frames);
+
+void renderScalar(UnisonLanes &lanes, float *L, float *R, int frames);
+
+Level detectLevel();
+bool isLevelAvailable(Level l);
+renderFn_t kernelFor(Level l); // returns nullptr if l isn't available on this machine
+const char *levelName(Level l);
+
+Level activeLevel();
+void selectLevel(Level l); // main thread only; ignored if l isn't available
+
+void render(UnisonLanes &lanes, float *L, float *R, int frames);
+} // namespace sst::clap_saw_demo::unison_kernel
+
+#endif // CLAP_SAW_DEMO_UNISON_SAW_KERNEL_H
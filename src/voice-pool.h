@@ -0,0 +1,412 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_VOICE_POOL_H
+#define CLAP_SAW_DEMO_VOICE_POOL_H
+
+/*
+ * VoicePool is the voice store for the synth. Each voice slot has three parts, each kept in
+ * its own array:
+ *
+ * - the hot SawDemoVoice (oscillator, envelope and filter state), cache line aligned
+ *   and only touched by the render loop and when a voice recalculates
+ * - the cold SawDemoVoice::Controls (note routing and base/modulation values) which
+ *   only the event handlers touch
+ * - a byte of occupancy per slot
+ *
+ * The slots in use are also threaded on an intrusive doubly linked active list, in the
+ * order they were allocated, and the free slots sit on a free stack. So allocate and free
+ * are O(1) and every visitor walks only the voices which are actually in use. With a handful
+ * of voices sounding, the render loop, the NEWLY_OFF sweep and the event handlers never
+ * touch the other slots at all.
+ *
+ * A slot is 'in use' from allocate until the engine sees its voice reach NEWLY_OFF and
+ * frees it, which is exactly the time its state is not SawDemoVoice::OFF.
+ *
+ * Two VoiceLookup hash indices map note ids and port / channel / key triples to the slots
+ * playing them, so polyphonic modulation and note expressions find their voices without a
+ * search. They are kept up to date by assignNote and free; so set a voice's routing through
+ * assignNote rather than writing those Controls directly.
+ *
+ * The pool is allocated for its full template capacity up front, but setCapacity limits
+ * how many slots allocate will hand out, so the polyphony can change at activate without
+ * allocating. When allocate fails the engine asks steal to choose a victim with one of the
+ * VoiceStealMode policies.
+ *
+ * The API is a handful of visitors, so the engine never iterates the arrays directly and
+ * the storage can change underneath it.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include "saw-voice.h"
+
+namespace sst::clap_saw_demo
+{
+/*
+ * How VoicePool::steal picks a voice when the pool is full. Whatever the policy, a voice in
+ * its attack stage is only taken if every voice is in its attack stage.
+ *
+ * - STEAL_OLDEST takes the voice which started longest ago
+ * - STEAL_QUIETEST takes the voice with the lowest envelope * VCA level
+ * - STEAL_RELEASING_FIRST takes the oldest released voice, then the oldest held one
+ * - STEAL_SAME_KEY retriggers a voice on the same port / channel / key if there is one,
+ *   and otherwise behaves like STEAL_RELEASING_FIRST
+ */
+enum VoiceStealMode
+{
+    STEAL_OLDEST,
+    STEAL_QUIETEST,
+    STEAL_RELEASING_FIRST,
+    STEAL_SAME_KEY
+};
+
+/*
+ * VoiceLookup is a fixed capacity open addressing hash multimap from a 32 bit key to voice
+ * slots. It never allocates. The table is at least twice the voice count so it is at most
+ * half full and probe runs stay short. Collisions probe linearly, and removal shifts the
+ * rest of the run back rather than leaving tombstones, so a table which sees millions of
+ * notes never degrades.
+ *
+ * Several voices can share a key (a retriggered key whose old voice is still releasing, or
+ * the host reusing a note id) so each entry is a (key, slot) pair and a lookup visits every
+ * entry with a matching key.
+ */
+template <int N> struct VoiceLookup
+{
+    static constexpr int tableSizeFor(int n)
+    {
+        int r = 1;
+        while (r < 2 * n)
+            r <<= 1;
+        return r;
+    }
+    static constexpr int tableSize = tableSizeFor(N);
+    static constexpr uint32_t mask = tableSize - 1;
+
+    VoiceLookup() { slot.fill(-1); }
+
+    void insert(uint32_t k, int s)
+    {
+        auto i = home(k);
+        while (slot[i] >= 0)
+            i = (i + 1) & mask;
+        key[i] = k;
+        slot[i] = (int16_t)s;
+    }
+
+    void remove(uint32_t k, int s)
+    {
+        auto i = home(k);
+        while (slot[i] >= 0 && !(key[i] == k && slot[i] == s))
+            i = (i + 1) & mask;
+        if (slot[i] < 0)
+            return;
+
+        // Backward shift: pull later entries of the run into the hole if the hole lies
+        // between their home position and where they sit now
+        slot[i] = -1;
+        auto j = i;
+        while (true)
+        {
+            j = (j + 1) & mask;
+            if (slot[j] < 0)
+                break;
+            auto h = home(key[j]);
+            if (((j - h) & mask) >= ((j - i) & mask))
+            {
+                key[i] = key[j];
+                slot[i] = slot[j];
+                slot[j] = -1;
+                i = j;
+            }
+        }
+    }
+
+    template <typename F> void forEach(uint32_t k, F &&f) const
+    {
+        for (auto i = home(k); slot[i] >= 0; i = (i + 1) & mask)
+            if (key[i] == k)
+                f((int)slot[i]);
+    }
+
+  private:
+    static uint32_t home(uint32_t k)
+    {
+        k *= 0x9E3779B1u;
+        return (k ^ (k >> 16)) & mask;
+    }
+
+    std::array<uint32_t, tableSize> key{};
+    std::array<int16_t, tableSize> slot;
+};
+
+template <int N> struct VoicePool
+{
+    static constexpr int capacity = N;
+    static_assert(N < INT16_MAX, "Voice indices are stored as int16_t");
+
+    VoicePool()
+    {
+        // Fill the free stack so allocation hands out slot 0 first
+        for (int i = 0; i < N; ++i)
+            freeStack[i] = (int16_t)(N - 1 - i);
+        freeCount = N;
+        limit = N;
+    }
+
+    /*
+     * Free every slot and limit the pool to the first `cap` (1...N) slots. The engine
+     * calls this from activate, so no voice is sounding and no NOTE_END is owed.
+     */
+    void reset(int cap)
+    {
+        forEachInUse([this](int i) { free(i); });
+
+        limit = std::clamp(cap, 1, N);
+        freeCount = 0;
+        for (int i = limit - 1; i >= 0; --i)
+            freeStack[freeCount++] = (int16_t)i;
+    }
+    int getCapacity() const { return limit; }
+
+    // Claim a free slot, returning its index or -1 if every voice is in use. The
+    // slot goes on the end of the active list.
+    int allocate()
+    {
+        if (freeCount == 0)
+            return -1;
+
+        auto i = freeStack[--freeCount];
+        used[i] = 1;
+        link(i);
+        activeCount++;
+        return i;
+    }
+
+    void free(int idx)
+    {
+        if (!used[idx])
+            return;
+
+        unlink(idx);
+        unindex(idx);
+        used[idx] = 0;
+        hot[idx].state = SawDemoVoice::OFF;
+        freeStack[freeCount++] = (int16_t)idx;
+        activeCount--;
+    }
+
+    bool inUse(int idx) const { return used[idx]; }
+    bool anyInUse() const { return activeCount > 0; }
+    int inUseCount() const { return activeCount; }
+
+    /*
+     * Choose an in use voice to give to a new note on port / channel / key, according to
+     * mode, and move it to the end of the active list (it is now the youngest voice).
+     * The caller reports the victim as terminated and then reassigns it.
+     */
+    int steal(VoiceStealMode mode, int port, int channel, int key)
+    {
+        int best{-1}, age{0};
+        float bestScore{0};
+
+        forEachInUse(
+            [&](int i)
+            {
+                const auto &v = hot[i];
+                const auto &c = cold[i];
+                auto released = v.state == SawDemoVoice::RELEASING ||
+                                v.state == SawDemoVoice::NEWLY_OFF;
+
+                // Ages count up oldest first and are always below N, so a bias of 2N in
+                // a score outranks any age
+                float score{0};
+                switch (mode)
+                {
+                case STEAL_OLDEST:
+                    score = age;
+                    break;
+                case STEAL_QUIETEST:
+                    score = v.currentLevel();
+                    break;
+                case STEAL_SAME_KEY:
+                    if (c.key == key && c.channel == channel && c.portid == port)
+                    {
+                        score = -2 * N;
+                        break;
+                    }
+                    // fall through
+                case STEAL_RELEASING_FIRST:
+                    score = age + (released ? 0 : 2 * N);
+                    break;
+                }
+                if (v.state == SawDemoVoice::ATTACK)
+                    score += 8 * N;
+
+                if (best < 0 || score < bestScore)
+                {
+                    best = i;
+                    bestScore = score;
+                }
+                age++;
+            });
+
+        if (best >= 0 && best != tail)
+        {
+            unlink(best);
+            link(best);
+        }
+        return best;
+    }
+
+    // Set the note routing of the voice in slot idx and update the lookup indices
+    void assignNote(int idx, int port, int channel, int key, int noteId)
+    {
+        unindex(idx);
+
+        auto &c = cold[idx];
+        c.portid = port;
+        c.channel = channel;
+        c.key = key;
+        c.note_id = noteId;
+
+        if (noteId >= 0)
+            byNoteId.insert((uint32_t)noteId, idx);
+        byPCK.insert(pckKey(port, channel, key), idx);
+        indexed[idx] = 1;
+    }
+
+    SawDemoVoice &voice(int idx) { return hot[idx]; }
+    SawDemoVoice::Controls &controls(int idx) { return cold[idx]; }
+
+    // Call f(idx) for every slot in use (including voices which are NEWLY_OFF), oldest
+    // first. It is safe for f to free idx.
+    template <typename F> void forEachInUse(F &&f)
+    {
+        for (int i = head; i >= 0;)
+        {
+            auto n = next[i];
+            f(i);
+            i = n;
+        }
+    }
+
+    // Call f(idx) for every slot whose voice is still sounding
+    template <typename F> void forEachPlaying(F &&f)
+    {
+        forEachInUse(
+            [&](int i)
+            {
+                if (hot[i].isPlaying())
+                    f(i);
+            });
+    }
+
+    // Call f(idx) for every sounding voice started with this note id
+    template <typename F> void forEachWithNoteId(int noteId, F &&f)
+    {
+        if (noteId < 0)
+            return;
+        byNoteId.forEach((uint32_t)noteId,
+                         [&](int i)
+                         {
+                             if (hot[i].isPlaying())
+                                 f(i);
+                         });
+    }
+
+    // Call f(idx) for every sounding voice started on this port / channel / key
+    template <typename F> void forEachWithPCK(int port, int channel, int key, F &&f)
+    {
+        byPCK.forEach(pckKey(port, channel, key),
+                      [&](int i)
+                      {
+                          const auto &c = cold[i];
+                          if (hot[i].isPlaying() && c.key == key && c.channel == channel &&
+                              c.portid == port)
+                              f(i);
+                      });
+    }
+
+    // Stamp the sample rate on every voice (idle or not)
+    void setSampleRate(double sr)
+    {
+        for (auto &v : hot)
+            v.sampleRate = sr;
+    }
+
+    // and whether they use the exact math path
+    void setExactMath(bool exact)
+    {
+        for (auto &v : hot)
+            v.exactMath = exact;
+    }
+
+  private:
+    alignas(64) std::array<SawDemoVoice, N> hot;
+    std::array<SawDemoVoice::Controls, N> cold;
+    std::array<uint8_t, N> used{};
+
+    // The active list runs head to tail in allocation order; -1 terminates
+    std::array<int16_t, N> next, prev;
+    int16_t head{-1}, tail{-1};
+    std::array<int16_t, N> freeStack;
+    int freeCount{0}, activeCount{0}, limit{N};
+
+    // Append idx to the end of the active list, or take it out
+    void link(int idx)
+    {
+        prev[idx] = tail;
+        next[idx] = -1;
+        if (tail >= 0)
+            next[tail] = (int16_t)idx;
+        else
+            head = (int16_t)idx;
+        tail = (int16_t)idx;
+    }
+
+    void unlink(int idx)
+    {
+        if (prev[idx] >= 0)
+            next[prev[idx]] = next[idx];
+        else
+            head = next[idx];
+        if (next[idx] >= 0)
+            prev[next[idx]] = prev[idx];
+        else
+            tail = prev[idx];
+    }
+
+    // Lookup indices on the routing in cold, for the slots with indexed set
+    VoiceLookup<N> byNoteId, byPCK;
+    std::array<uint8_t, N> indexed{};
+
+    // Keys and channels are 7 and 4 bit; the port gets the rest. The lookup compares the
+    // full triple so an out of range (and so aliasing) port is merely slower.
+    static uint32_t pckKey(int port, int channel, int key)
+    {
+        return ((uint32_t)port << 16) ^ (((uint32_t)channel & 0xFF) << 8) ^ (uint32_t)key;
+    }
+
+    void unindex(int idx)
+    {
+        if (!indexed[idx])
+            return;
+        const auto &c = cold[idx];
+        if (c.note_id >= 0)
+            byNoteId.remove((uint32_t)c.note_id, idx);
+        byPCK.remove(pckKey(c.portid, c.channel, c.key), idx);
+        indexed[idx] = 0;
+    }
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_VOICE_POOL_H
@@ -0,0 +1,198 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#include "voice-quad.h"
+#include "simd-f4.h"
+#include <cstring>
+
+namespace sst::clap_saw_demo
+{
+void QuadSimperSVF::gather(SawDemoVoice::StereoSimperSVF *const f[lanes])
+{
+    for (int l = 0; l < lanes; ++l)
+    {
+        auto *q = f[l];
+        if (!q)
+        {
+            for (int c = 0; c < 2; ++c)
+            {
+                ic1eq[c][l] = 0.f;
+                ic2eq[c][l] = 0.f;
+            }
+            a1[l] = a2[l] = a3[l] = ak[l] = 0.f;
+            mixLow[l] = mixBand[l] = mixHigh[l] = 0.f;
+            continue;
+        }
+
+        for (int c = 0; c < 2; ++c)
+        {
+            ic1eq[c][l] = q->ic1eq[c];
+            ic2eq[c][l] = q->ic2eq[c];
+        }
+        a1[l] = q->a1;
+        a2[l] = q->a2;
+        a3[l] = q->a3;
+        ak[l] = q->ak;
+
+        // v2 is low, v1 is band and v0 is high, and the other modes mix those
+        float lo{0}, bd{0}, hi{0};
+        switch (q->mode)
+        {
+        case SawDemoVoice::StereoSimperSVF::LP:
+            lo = 1;
+            break;
+        case SawDemoVoice::StereoSimperSVF::BP:
+            bd = 1;
+            break;
+        case SawDemoVoice::StereoSimperSVF::HP:
+            hi = 1;
+            break;
+        case SawDemoVoice::StereoSimperSVF::NOTCH:
+            lo = 1;
+            hi = 1;
+            break;
+        case SawDemoVoice::StereoSimperSVF::PEAK:
+            lo = 1;
+            hi = -1;
+            break;
+        case SawDemoVoice::StereoSimperSVF::ALL:
+            lo = 1;
+            bd = -q->k;
+            hi = 1;
+            break;
+        }
+        mixLow[l] = lo;
+        mixBand[l] = bd;
+        mixHigh[l] = hi;
+    }
+}
+
+void QuadSimperSVF::scatter(SawDemoVoice::StereoSimperSVF *const f[lanes]) const
+{
+    for (int l = 0; l < lanes; ++l)
+    {
+        auto *q = f[l];
+        if (!q)
+            continue;
+        for (int c = 0; c < 2; ++c)
+        {
+            q->ic1eq[c] = ic1eq[c][l];
+            q->ic2eq[c] = ic2eq[c][l];
+        }
+    }
+}
+
+void QuadSimperSVF::process(float *const L[lanes], float *const R[lanes], int frames)
+{
+    const auto va1 = f4Load(a1), va2 = f4Load(a2), va3 = f4Load(a3), vak = f4Load(ak);
+    const auto mLo = f4Load(mixLow), mBd = f4Load(mixBand), mHi = f4Load(mixHigh);
+
+    float *const *io[2]{L, R};
+    for (int c = 0; c < 2; ++c)
+    {
+        auto i1 = f4Load(ic1eq[c]), i2 = f4Load(ic2eq[c]);
+        auto *const *d = io[c];
+
+        auto tick = [&](f4_t in)
+        {
+            auto v3 = f4Sub(in, i2);
+            auto v0 = f4Sub(f4Mul(va1, v3), f4Mul(vak, i1));
+            auto v1 = f4Add(f4Mul(va2, v3), f4Mul(va1, i1));
+            auto v2 = f4Add(f4Add(f4Mul(va3, v3), f4Mul(va2, i1)), i2);
+
+            i1 = f4Sub(f4Add(v1, v1), i1);
+            i2 = f4Sub(f4Add(v2, v2), i2);
+
+            return f4Add(f4Add(f4Mul(mLo, v2), f4Mul(mBd, v1)), f4Mul(mHi, v0));
+        };
+
+        // The lanes are stored sample-major per voice, so take them four samples at a time
+        // and transpose to get one register per sample across the four voices
+        int s = 0;
+        for (; s + 4 <= frames; s += 4)
+        {
+            auto r0 = f4LoadU(d[0] + s), r1 = f4LoadU(d[1] + s), r2 = f4LoadU(d[2] + s),
+                 r3 = f4LoadU(d[3] + s);
+            f4Transpose(r0, r1, r2, r3);
+            r0 = tick(r0);
+            r1 = tick(r1);
+            r2 = tick(r2);
+            r3 = tick(r3);
+            f4Transpose(r0, r1, r2, r3);
+            f4StoreU(d[0] + s, r0);
+            f4StoreU(d[1] + s, r1);
+            f4StoreU(d[2] + s, r2);
+            f4StoreU(d[3] + s, r3);
+        }
+        for (; s < frames; ++s)
+        {
+            alignas(16) float o[4];
+            f4Store(o, tick(f4Set(d[0][s], d[1][s], d[2][s], d[3][s])));
+            for (int l = 0; l < lanes; ++l)
+                d[l][s] = o[l];
+        }
+
+        f4Store(ic1eq[c], i1);
+        f4Store(ic2eq[c], i2);
+    }
+}
+
+void VoiceQuad::render(SawDemoVoice *const voices[lanes], int count, float *busL, float *busR,
+                       int frames)
+{
+    alignas(16) float laneL[lanes][SawDemoVoice::blockSize], laneR[lanes][SawDemoVoice::blockSize];
+    float *L[lanes], *R[lanes];
+    SawDemoVoice::StereoSimperSVF *filters[lanes];
+    int alive[lanes];
+
+    for (int l = 0; l < lanes; ++l)
+    {
+        L[l] = laneL[l];
+        R[l] = laneR[l];
+        if (l < count)
+        {
+            filters[l] = &voices[l]->filter;
+            alive[l] = voices[l]->renderUnfiltered(L[l], R[l], frames);
+        }
+        else
+        {
+            filters[l] = nullptr;
+            alive[l] = 0;
+        }
+
+        // A voice which ended mid block (or an empty lane) feeds silence for the rest
+        if (alive[l] < frames)
+        {
+            memset(L[l] + alive[l], 0, (frames - alive[l]) * sizeof(float));
+            memset(R[l] + alive[l], 0, (frames - alive[l]) * sizeof(float));
+        }
+    }
+
+    QuadSimperSVF q;
+    q.gather(filters);
+    q.process(L, R, frames);
+    q.scatter(filters);
+
+    for (int l = 0; l < count; ++l)
+    {
+        voices[l]->trackSilence(L[l], R[l], alive[l]);
+        if (!voices[l]->isPlaying())
+            voices[l]->endedAt = alive[l] - 1;
+    }
+
+    for (int l = 0; l < count; ++l)
+    {
+        for (int s = 0; s < alive[l]; ++s)
+        {
+            busL[s] += L[l][s];
+            busR[s] += R[l][s];
+        }
+    }
+}
+} // namespace sst::clap_saw_demo
@@ -0,0 +1,61 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_VOICE_QUAD_H
+#define CLAP_SAW_DEMO_VOICE_QUAD_H
+
+/*
+ * The voice quad renders up to four voices at once. Each voice renders its oscillator and
+ * envelope into its own scratch lane, and then a single QuadSimperSVF filters all four lanes
+ * together with one SIMD register holding the same channel of four different voices.
+ *
+ * The filter state still lives in each voice's StereoSimperSVF; the quad gathers the
+ * integrators and coefficients into registers at the start of a block and scatters them
+ * back at the end. That way voices can join and leave quads from block to block without
+ * any bookkeeping.
+ *
+ * The filter mode is resolved once per block into three output mix coefficients per lane
+ * (out = low * v2 + band * v1 + high * v0), so four voices with different modes still share
+ * one branch-free loop.
+ */
+
+#include "saw-voice.h"
+
+namespace sst::clap_saw_demo
+{
+struct QuadSimperSVF
+{
+    static constexpr int lanes = 4;
+
+    alignas(16) float ic1eq[2][lanes], ic2eq[2][lanes];
+    alignas(16) float a1[lanes], a2[lanes], a3[lanes], ak[lanes];
+    alignas(16) float mixLow[lanes], mixBand[lanes], mixHigh[lanes];
+
+    // Load state from up to `lanes` filters. Missing lanes (nullptr) are silent.
+    void gather(SawDemoVoice::StereoSimperSVF *const f[lanes]);
+    void scatter(SawDemoVoice::StereoSimperSVF *const f[lanes]) const;
+
+    // Filter `frames` samples in place in each of the four stereo lanes
+    void process(float *const L[lanes], float *const R[lanes], int frames);
+};
+
+struct VoiceQuad
+{
+    static constexpr int lanes = QuadSimperSVF::lanes;
+
+    /*
+     * Render `count` (1...lanes) voices for `frames` (at most SawDemoVoice::blockSize)
+     * samples and add them to the stereo bus.
+     */
+    static void render(SawDemoVoice *const voices[lanes], int count, float *busL, float *busR,
+                       int frames);
+};
+} // namespace sst::clap_saw_demo
+
+#endif // CLAP_SAW_DEMO_VOICE_QUAD_H
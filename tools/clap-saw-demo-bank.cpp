@@ -0,0 +1,178 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+/*
+ * clap-saw-demo-bank builds and inspects preset banks (see src/preset-bank.h).
+ *
+ * A bank is built from a text file with one preset per line, in the same id=value form as
+ * the old text state:
+ *
+ *   Warm Pad;17=62;94=0.4;2391=35;2874=0.6;
+ *   # comments and blank lines are skipped
+ *
+ * Parameters a line doesn't mention get their defaults. `random` writes a bank of random
+ * presets, which is handy for seeing how a host copes with indexing a very large bank.
+ *
+ * Usage:
+ *   clap-saw-demo-bank build <out.csdbank> <presets.txt>
+ *   clap-saw-demo-bank list <bank.csdbank>
+ *   clap-saw-demo-bank random <out.csdbank> <count>
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "clap-saw-demo.h"
+
+using namespace sst::clap_saw_demo;
+
+namespace
+{
+std::vector<clap_id> allIds()
+{
+    std::vector<clap_id> ids;
+    for (const auto &pd : ClapSawDemo::paramDefs)
+        ids.push_back(pd.id);
+    return ids;
+}
+
+PresetBankEntry defaultPreset(const std::string &name)
+{
+    PresetBankEntry e;
+    e.name = name;
+    for (const auto &pd : ClapSawDemo::paramDefs)
+        e.values.push_back(pd.defaultValue);
+    return e;
+}
+
+int build(const char *out, const char *in)
+{
+    std::ifstream f(in);
+    if (!f)
+    {
+        fprintf(stderr, "Unable to read '%s'\n", in);
+        return 1;
+    }
+
+    std::vector<PresetBankEntry> presets;
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(f, line))
+    {
+        ++lineNo;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        auto semi = line.find(';');
+        auto e = defaultPreset(line.substr(0, semi));
+        while (semi != std::string::npos)
+        {
+            auto next = line.find(';', semi + 1);
+            auto item = line.substr(semi + 1, next == std::string::npos ? next : next - semi - 1);
+            semi = next;
+            if (item.empty())
+                continue;
+
+            auto eq = item.find('=');
+            auto idx = eq == std::string::npos
+                           ? -1
+                           : ClapSawDemo::paramIndex.indexOf(
+                                 (clap_id)std::strtoul(item.substr(0, eq).c_str(), nullptr, 10));
+            if (idx < 0)
+            {
+                fprintf(stderr, "%s:%d: ignoring '%s'\n", in, lineNo, item.c_str());
+                continue;
+            }
+            e.values[idx] = std::atof(item.substr(eq + 1).c_str());
+        }
+        presets.push_back(std::move(e));
+    }
+
+    if (!writePresetBank(out, allIds(), presets))
+    {
+        fprintf(stderr, "Unable to write '%s'\n", out);
+        return 1;
+    }
+    printf("Wrote %zu presets to %s\n", presets.size(), out);
+    return 0;
+}
+
+int list(const char *path)
+{
+    PresetBank bank;
+    if (!bank.open(path))
+    {
+        fprintf(stderr, "%s: %s\n", path, bank.errorMessage());
+        return 1;
+    }
+    printf("%s: %u presets of %u parameters\n", path, bank.presetCount(), bank.paramCount());
+    for (uint32_t i = 0; i < bank.presetCount(); ++i)
+    {
+        auto *name = bank.name(i);
+        printf("%6u  %s\n", i, name ? name : "<damaged>");
+    }
+    return 0;
+}
+
+int randomBank(const char *out, int count)
+{
+    std::mt19937 gen(2022);
+    std::vector<PresetBankEntry> presets;
+    for (int i = 0; i < count; ++i)
+    {
+        auto e = defaultPreset("Random " + std::to_string(i + 1));
+        for (int p = 0; p < ClapSawDemo::nParams; ++p)
+        {
+            const auto &pd = ClapSawDemo::paramDefs[p];
+
+            // Leave the parameters which restart the engine alone
+            if (pd.id == ClapSawDemo::pmPolyphony || pd.id == ClapSawDemo::pmOversampling)
+                continue;
+            auto v = std::uniform_real_distribution<double>(pd.minValue, pd.maxValue)(gen);
+            e.values[p] = (pd.flags & CLAP_PARAM_IS_STEPPED) ? std::round(v) : v;
+        }
+        presets.push_back(std::move(e));
+    }
+
+    if (!writePresetBank(out, allIds(), presets))
+    {
+        fprintf(stderr, "Unable to write '%s'\n", out);
+        return 1;
+    }
+    printf("Wrote %d presets to %s\n", count, out);
+    return 0;
+}
+
+int usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s build <out.csdbank> <presets.txt>\n"
+            "       %s list <bank.csdbank>\n"
+            "       %s random <out.csdbank> <count>\n",
+            argv0, argv0, argv0);
+    return 2;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && !strcmp(argv[1], "build"))
+        return build(argv[2], argv[3]);
+    if (argc == 3 && !strcmp(argv[1], "list"))
+        return list(argv[2]);
+    if (argc == 4 && !strcmp(argv[1], "random"))
+        return randomBank(argv[2], std::atoi(argv[3]));
+    return usage(argv[0]);
+}
@@ -0,0 +1,323 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+/*
+ * clap-saw-demo-bench is a headless render benchmark for the synth engine. It compiles
+ * ClapSawDemo without a GUI, creates it with a stub clap_host, and drives it through its
+ * clap_plugin interface (init, params flush, activate, process) just as a host would.
+ *
+ * For every combination of sample rate, block size, unison count and voice count it
+ * holds that many notes, optionally with a stream of automation and polyphonic modulation
+ * events, and times each call to process. The results go to stdout as JSON:
+ *
+ * - ns_per_sample_per_voice: process time divided by frames * voices
+ * - realtime_factor: seconds of audio rendered per second of wall clock
+ * - block_us_mean / block_us_p99 / block_us_max: the distribution of process call times
+ * - block_budget_p99: the p99 block time as a fraction of the block's duration
+ *
+ * Usage:
+ *   clap-saw-demo-bench [--seconds 2] [--sample-rates 44100,48000,96000]
+ *                       [--block-sizes 32,128,512] [--unison 1,3,7] [--voices 1,8,32,64]
+ *                       [--automation 0,1] [--kernel scalar|sse2|avx|neon]
+ *                       [--precision approximate|exact] [--oversampling 1|2|4]
+ *
+ * The engine's own debug logging is sent to stderr. Each run renders a quarter second
+ * before timing starts so the notes are past their attack and the caches are warm.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "clap-saw-demo.h"
+#include "fast-math.h"
+#include "unison-saw-kernel.h"
+
+#include "host-event-list.h"
+
+using namespace sst::clap_saw_demo;
+using tools::HostEventList;
+
+namespace
+{
+struct Scenario
+{
+    double sampleRate;
+    uint32_t blockSize;
+    int unison;
+    int voices;
+    bool automation;
+};
+
+struct Result
+{
+    Scenario scenario;
+    double nsPerSamplePerVoice, realtimeFactor;
+    double blockUsMean, blockUsP99, blockUsMax;
+    double blockBudgetP99;
+};
+
+/*
+ * The stub host supports no extensions and ignores every request. The synth copes with
+ * a host that offers nothing, which is all we need to render.
+ */
+const void *hostGetExtension(const clap_host *, const char *) { return nullptr; }
+void hostRequestNothing(const clap_host *) {}
+
+// The value of the oversampling parameter every scenario runs with
+double oversamplingMode{0};
+
+const clap_host stubHost = {CLAP_VERSION,        nullptr,           "clap-saw-demo-bench",
+                            "Surge Synth Team",  "",                "1.0.0",
+                            hostGetExtension,    hostRequestNothing, hostRequestNothing,
+                            hostRequestNothing};
+
+/*
+ * Automation mode sends a cutoff sweep value every 64 samples and a polyphonic cutoff
+ * modulation to each held note every 256 samples, staggered across the block.
+ */
+void buildAutomation(HostEventList &el, const Scenario &s, uint64_t blockStart)
+{
+    for (uint32_t f = 0; f < s.blockSize; ++f)
+    {
+        auto pos = blockStart + f;
+        if (pos % 64 == 0)
+            el.paramValue(f, ClapSawDemo::pmCutoff, 70 + 30 * std::sin(pos * 1e-4));
+        auto slot = pos % 256;
+        for (int v = (int)slot; v < s.voices; v += 256)
+            el.paramMod(f, ClapSawDemo::pmCutoff, v, 12 * std::sin(pos * 3e-4 + v));
+    }
+}
+
+Result runScenario(const Scenario &s, double seconds)
+{
+    auto *synth = new ClapSawDemo(&stubHost);
+    auto *plugin = synth->clapPlugin();
+    plugin->init(plugin);
+
+    // Set up the patch before activating, since polyphony and oversampling only apply there
+    auto params = static_cast<const clap_plugin_params_t *>(
+        plugin->get_extension(plugin, CLAP_EXT_PARAMS));
+    HostEventList el;
+    el.paramValue(0, ClapSawDemo::pmUnisonCount, s.unison);
+    el.paramValue(0, ClapSawDemo::pmPolyphony, std::max(s.voices, 1));
+    el.paramValue(0, ClapSawDemo::pmOversampling, oversamplingMode);
+    params->flush(plugin, &el.in, &tools::discardOutputEvents);
+
+    plugin->activate(plugin, s.sampleRate, 1, s.blockSize);
+    plugin->start_processing(plugin);
+
+    std::vector<float> L(s.blockSize), R(s.blockSize);
+    float *outs[2]{L.data(), R.data()};
+    clap_audio_buffer_t buffer{};
+    buffer.data32 = outs;
+    buffer.channel_count = 2;
+
+    clap_process_t process{};
+    process.frames_count = s.blockSize;
+    process.audio_outputs = &buffer;
+    process.audio_outputs_count = 1;
+    process.in_events = &el.in;
+    process.out_events = &tools::discardOutputEvents;
+
+    auto warmupBlocks = (uint64_t)std::ceil(0.25 * s.sampleRate / s.blockSize);
+    auto timedBlocks = std::max((uint64_t)1, (uint64_t)(seconds * s.sampleRate / s.blockSize));
+
+    std::vector<double> blockNs;
+    blockNs.reserve(timedBlocks);
+    el.events.reserve(s.blockSize + s.blockSize * (s.voices / 256 + 1) + s.voices);
+
+    for (uint64_t b = 0; b < warmupBlocks + timedBlocks; ++b)
+    {
+        el.clear();
+        if (b == 0)
+        {
+            for (int v = 0; v < s.voices; ++v)
+                el.noteOn(0, 24 + v % 96, v);
+        }
+        if (s.automation)
+            buildAutomation(el, s, b * s.blockSize);
+        el.sortByTime();
+        process.steady_time = (int64_t)(b * s.blockSize);
+
+        auto t0 = std::chrono::steady_clock::now();
+        plugin->process(plugin, &process);
+        auto t1 = std::chrono::steady_clock::now();
+
+        if (b >= warmupBlocks)
+            blockNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+    }
+
+    plugin->stop_processing(plugin);
+    plugin->deactivate(plugin);
+    plugin->destroy(plugin);
+
+    double total{0};
+    for (auto n : blockNs)
+        total += n;
+    std::sort(blockNs.begin(), blockNs.end());
+    auto p99 = blockNs[(size_t)std::ceil(0.99 * blockNs.size()) - 1];
+    auto frames = (double)blockNs.size() * s.blockSize;
+    auto blockSeconds = s.blockSize / s.sampleRate;
+
+    Result r;
+    r.scenario = s;
+    r.nsPerSamplePerVoice = total / (frames * std::max(s.voices, 1));
+    r.realtimeFactor = (frames / s.sampleRate) / (total * 1e-9);
+    r.blockUsMean = total / blockNs.size() * 1e-3;
+    r.blockUsP99 = p99 * 1e-3;
+    r.blockUsMax = blockNs.back() * 1e-3;
+    r.blockBudgetP99 = p99 * 1e-9 / blockSeconds;
+    return r;
+}
+
+template <typename T> std::vector<T> parseList(const char *arg)
+{
+    std::vector<T> res;
+    std::string s(arg);
+    size_t pos{0};
+    while (pos <= s.size())
+    {
+        auto next = s.find(',', pos);
+        if (next == std::string::npos)
+            next = s.size();
+        if (next > pos)
+            res.push_back((T)std::atof(s.substr(pos, next - pos).c_str()));
+        pos = next + 1;
+    }
+    return res;
+}
+
+int usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--seconds S] [--sample-rates a,b] [--block-sizes a,b] [--unison a,b]\n"
+            "          [--voices a,b] [--automation 0,1] [--kernel scalar|sse2|avx|neon]\n"
+            "          [--precision approximate|exact] [--oversampling 1|2|4]\n",
+            argv0);
+    return 1;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // The engine's debug output goes to std::cout; keep stdout for the JSON
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    double seconds{2.0};
+    std::vector<double> sampleRates{44100, 48000, 96000};
+    std::vector<uint32_t> blockSizes{32, 128, 512};
+    std::vector<int> unisons{1, 3, 7};
+    std::vector<int> voiceCounts{1, 8, 32, 64};
+    std::vector<int> automations{0, 1};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        if (i + 1 >= argc)
+            return usage(argv[0]);
+        auto val = argv[++i];
+
+        if (arg == "--seconds")
+            seconds = std::atof(val);
+        else if (arg == "--sample-rates")
+            sampleRates = parseList<double>(val);
+        else if (arg == "--block-sizes")
+            blockSizes = parseList<uint32_t>(val);
+        else if (arg == "--unison")
+            unisons = parseList<int>(val);
+        else if (arg == "--voices")
+            voiceCounts = parseList<int>(val);
+        else if (arg == "--automation")
+            automations = parseList<int>(val);
+        else if (arg == "--kernel")
+        {
+            bool found{false};
+            for (auto l : {unison_kernel::Level::Scalar, unison_kernel::Level::SSE2,
+                           unison_kernel::Level::AVX, unison_kernel::Level::NEON})
+            {
+                if (strcmp(val, unison_kernel::levelName(l)) == 0 &&
+                    unison_kernel::isLevelAvailable(l))
+                {
+                    unison_kernel::selectLevel(l);
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                fprintf(stderr, "Kernel '%s' is not available on this machine\n", val);
+                return 1;
+            }
+        }
+        else if (arg == "--precision")
+        {
+            if (strcmp(val, "exact") == 0)
+                fast_math::selectPrecision(fast_math::Precision::Exact);
+            else if (strcmp(val, "approximate") == 0)
+                fast_math::selectPrecision(fast_math::Precision::Approximate);
+            else
+                return usage(argv[0]);
+        }
+        else if (arg == "--oversampling")
+        {
+            auto factor = std::atoi(val);
+            if (factor != 1 && factor != 2 && factor != 4)
+                return usage(argv[0]);
+            oversamplingMode = factor == 4 ? 2 : factor - 1;
+        }
+        else
+            return usage(argv[0]);
+    }
+
+    if (seconds <= 0 || sampleRates.empty() || blockSizes.empty() || unisons.empty() ||
+        voiceCounts.empty() || automations.empty())
+        return usage(argv[0]);
+
+    printf("{\n");
+    printf("  \"plugin\": \"%s\",\n", ClapSawDemo::desc.id);
+    printf("  \"version\": \"%s\",\n", ClapSawDemo::desc.version);
+    printf("  \"kernel\": \"%s\",\n", unison_kernel::levelName(unison_kernel::activeLevel()));
+    printf("  \"precision\": \"%s\",\n",
+           fast_math::activePrecision() == fast_math::Precision::Exact ? "exact"
+                                                                       : "approximate");
+    printf("  \"oversampling\": %d,\n", 1 << (int)oversamplingMode);
+    printf("  \"seconds\": %g,\n", seconds);
+    printf("  \"results\": [\n");
+
+    bool first{true};
+    for (auto sr : sampleRates)
+        for (auto bs : blockSizes)
+            for (auto uni : unisons)
+                for (auto vc : voiceCounts)
+                    for (auto au : automations)
+                    {
+                        if (sr <= 0 || bs == 0 || vc < 0)
+                            continue;
+
+                        auto r = runScenario({sr, bs, uni, vc, au != 0}, seconds);
+                        printf("%s    {\"sample_rate\": %g, \"block_size\": %u, \"unison\": %d, "
+                               "\"voices\": %d, \"automation\": %s, "
+                               "\"ns_per_sample_per_voice\": %.3f, \"realtime_factor\": %.3f, "
+                               "\"block_us_mean\": %.3f, \"block_us_p99\": %.3f, "
+                               "\"block_us_max\": %.3f, \"block_budget_p99\": %.5f}",
+                               first ? "" : ",\n", sr, bs, uni, vc, au ? "true" : "false",
+                               r.nsPerSamplePerVoice, r.realtimeFactor, r.blockUsMean,
+                               r.blockUsP99, r.blockUsMax, r.blockBudgetP99);
+                        fflush(stdout);
+                        first = false;
+                    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
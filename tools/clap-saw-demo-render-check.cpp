@@ -0,0 +1,563 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+/*
+ * clap-saw-demo-render-check is an offline regression check for the sound of the synth.
+ * It loads a built clap-saw-demo.clap through clap_entry and its plugin factory, exactly as
+ * a host would, and renders a set of canonical scenes:
+ *
+ * - a held chord, a unison count and spread sweep
+ * - a resonant cutoff sweep in each StereoSimperSVF mode
+ * - a MIDI pitch bend sweep, polyphonic modulation, and note expressions
+ * - a large chord with a cutoff sweep at 2x and 4x oversampling, and bounced offline, which
+ *   play enough voices that the engine splits them into render tasks for a thread pool
+ *
+ * With --record it writes each scene as a 32 bit float stereo WAV into a directory of
+ * references, creating the directory if need be. With --compare it renders again and checks
+ * each scene against its reference, printing the largest sample difference and failing
+ * (exit code 1) if any scene differs by more than --tolerance. So the workflow for a change
+ * which shouldn't alter the sound is to record references from a build before the change
+ * and compare a build after it.
+ * --tolerance 0 demands a bit exact match; the default allows differences around -80dB,
+ * which is the size of change the fast math approximations make.
+ *
+ * Usage:
+ *   clap-saw-demo-render-check <path/to/clap-saw-demo.clap> --record <dir>
+ *   clap-saw-demo-render-check <path/to/clap-saw-demo.clap> --compare <dir>
+ *       [--tolerance 1e-4] [--block-size 256] [--sample-rate 48000] [--scene name]
+ *       [--out <dir to write this render's wavs>]
+ *
+ * Rendering at a different block size from the references is a good way to check that the
+ * block and event slicing code doesn't change the output.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "clap-saw-demo.h"
+
+#include "host-event-list.h"
+
+using namespace sst::clap_saw_demo;
+using tools::HostEventList;
+
+namespace
+{
+/*
+ * Scenes are scripts which add the events falling in each block. Times in a script are in
+ * seconds so a scene plays the same at any sample rate.
+ */
+struct Block
+{
+    HostEventList &el;
+    uint64_t start;
+    uint32_t frames;
+    double sampleRate;
+
+    // Call f(offset) if the time t (in seconds) falls in this block
+    template <typename F> void at(double t, F f) const
+    {
+        auto s = (uint64_t)std::llround(t * sampleRate);
+        if (s >= start && s < start + frames)
+            f((uint32_t)(s - start));
+    }
+
+    // Call f(offset, t) every `period` samples, with t the time in seconds
+    template <typename F> void every(uint64_t period, F f) const
+    {
+        auto first = (start + period - 1) / period * period;
+        for (auto s = first; s < start + frames; s += period)
+            f((uint32_t)(s - start), s / sampleRate);
+    }
+};
+
+struct Scene
+{
+    std::string name;
+    double seconds;
+    void (*script)(const Block &);
+
+    // Both only take effect at activate, so renderScene sets them up before it
+    int oversampling{0}; // the pmOversampling value
+    bool offline{false}; // render through CLAP_RENDER_OFFLINE
+};
+
+void chordScene(const Block &b)
+{
+    const int keys[] = {48, 52, 55, 59, 62};
+    for (int i = 0; i < 5; ++i)
+    {
+        b.at(0.05 * i, [&](auto o) { b.el.noteOn(o, keys[i], i + 1, 0.5 + 0.1 * i); });
+        b.at(1.2, [&](auto o) { b.el.noteOff(o, keys[i], i + 1); });
+    }
+}
+
+void unisonSweepScene(const Block &b)
+{
+    b.at(0, [&](auto o) { b.el.noteOn(o, 45, 1); });
+    for (int u = 1; u <= SawDemoVoice::max_uni; ++u)
+        b.at(0.25 * (u - 1),
+             [&](auto o) { b.el.paramValue(o, ClapSawDemo::pmUnisonCount, u); });
+    b.every(64, [&](auto o, auto t)
+            { b.el.paramValue(o, ClapSawDemo::pmUnisonSpread, 100 * t / 2.0); });
+    b.at(1.8, [&](auto o) { b.el.noteOff(o, 45, 1); });
+}
+
+template <SawDemoVoice::StereoSimperSVF::Mode mode> void filterScene(const Block &b)
+{
+    b.at(0, [&](auto o) {
+        b.el.paramValue(o, ClapSawDemo::pmFilterMode, mode);
+        b.el.paramValue(o, ClapSawDemo::pmResonance, 0.8);
+        b.el.noteOn(o, 40, 1);
+        b.el.noteOn(o, 52, 2);
+    });
+    b.every(64, [&](auto o, auto t)
+            { b.el.paramValue(o, ClapSawDemo::pmCutoff, 20 + 100 * t / 2.0); });
+    b.at(1.6, [&](auto o) {
+        b.el.noteOff(o, 40, 1);
+        b.el.noteOff(o, 52, 2);
+    });
+}
+
+void pitchBendScene(const Block &b)
+{
+    b.at(0, [&](auto o) { b.el.noteOn(o, 57, 1); });
+    b.every(128, [&](auto o, auto t) {
+        auto bend = (int)std::lround(8192 + 8191 * std::sin(2 * M_PI * 1.5 * t));
+        b.el.midi(o, 0xE0, bend & 0x7F, (bend >> 7) & 0x7F);
+    });
+    b.at(1.6, [&](auto o) { b.el.noteOff(o, 57, 1); });
+}
+
+void polyModScene(const Block &b)
+{
+    b.at(0, [&](auto o) {
+        b.el.noteOn(o, 48, 1);
+        b.el.noteOn(o, 55, 2);
+    });
+    b.every(64, [&](auto o, auto t) {
+        b.el.paramMod(o, ClapSawDemo::pmCutoff, 1, 24 * std::sin(2 * M_PI * 2 * t));
+        b.el.paramMod(o, ClapSawDemo::pmOscDetune, 2, 50 * std::sin(2 * M_PI * 0.7 * t));
+        b.el.paramMod(o, ClapSawDemo::pmPreFilterVCA, 2, -0.5 * t / 2.0);
+    });
+    b.at(1.5, [&](auto o) {
+        b.el.noteOff(o, 48, 1);
+        b.el.noteOff(o, 55, 2);
+    });
+}
+
+void noteExpressionScene(const Block &b)
+{
+    b.at(0, [&](auto o) {
+        b.el.noteOn(o, 50, 1);
+        b.el.noteOn(o, 57, 2);
+    });
+    b.every(128, [&](auto o, auto t) {
+        b.el.noteExpression(o, CLAP_NOTE_EXPRESSION_TUNING, 50, 2 * std::sin(2 * M_PI * t));
+        b.el.noteExpression(o, CLAP_NOTE_EXPRESSION_VOLUME, 57, 1 - 0.8 * t / 2.0);
+    });
+    b.at(1.5, [&](auto o) {
+        b.el.noteOff(o, 50, 1);
+        b.el.noteOff(o, 57, 2);
+    });
+}
+
+/*
+ * 32 voices, so the engine has more than ClapSawDemo::minTasksForPool render tasks and uses a
+ * thread pool where it has one, with a cutoff sweep so the smoothed values move inside
+ * every render span.
+ */
+void bigChordScene(const Block &b)
+{
+    for (int i = 0; i < 32; ++i)
+    {
+        b.at(0.01 * i, [&](auto o) { b.el.noteOn(o, 36 + 2 * i, i + 1, 0.3); });
+        b.at(1.2 + 0.005 * i, [&](auto o) { b.el.noteOff(o, 36 + 2 * i, i + 1); });
+    }
+    b.every(64, [&](auto o, auto t)
+            { b.el.paramValue(o, ClapSawDemo::pmCutoff, 40 + 60 * t / 2.0); });
+}
+
+std::vector<Scene> scenes()
+{
+    using F = SawDemoVoice::StereoSimperSVF;
+    return {{"chord", 2.0, chordScene},
+            {"unison-sweep", 2.0, unisonSweepScene},
+            {"filter-lp", 2.0, filterScene<F::LP>},
+            {"filter-hp", 2.0, filterScene<F::HP>},
+            {"filter-bp", 2.0, filterScene<F::BP>},
+            {"filter-notch", 2.0, filterScene<F::NOTCH>},
+            {"filter-peak", 2.0, filterScene<F::PEAK>},
+            {"filter-all", 2.0, filterScene<F::ALL>},
+            {"pitch-bend", 2.0, pitchBendScene},
+            {"poly-mod", 2.0, polyModScene},
+            {"note-expression", 2.0, noteExpressionScene},
+            {"oversample-2x", 2.0, bigChordScene, 1},
+            {"oversample-4x", 2.0, bigChordScene, 2},
+            {"offline", 2.0, bigChordScene, 0, true}};
+}
+
+/*
+ * Loading the plugin. On macOS the .clap is a bundle and the binary lives inside it.
+ */
+struct LoadedClap
+{
+    void *handle{nullptr};
+    const clap_plugin_entry_t *entry{nullptr};
+
+    bool load(const std::string &path)
+    {
+        auto binary = path;
+#if defined(__APPLE__)
+        auto slash = binary.find_last_of('/');
+        auto stem = binary.substr(slash == std::string::npos ? 0 : slash + 1);
+        if (stem.size() > 5 && stem.substr(stem.size() - 5) == ".clap")
+            binary += "/Contents/MacOS/" + stem.substr(0, stem.size() - 5);
+#endif
+
+#if defined(_WIN32)
+        auto h = LoadLibraryA(binary.c_str());
+        handle = h;
+        if (h)
+            entry = (const clap_plugin_entry_t *)GetProcAddress(h, "clap_entry");
+#else
+        handle = dlopen(binary.c_str(), RTLD_LOCAL | RTLD_NOW);
+        if (!handle)
+            std::cerr << dlerror() << std::endl;
+        else
+            entry = (const clap_plugin_entry_t *)dlsym(handle, "clap_entry");
+#endif
+        return entry && entry->init(path.c_str());
+    }
+
+    ~LoadedClap()
+    {
+        if (entry)
+            entry->deinit();
+#if defined(_WIN32)
+        if (handle)
+            FreeLibrary((HMODULE)handle);
+#else
+        if (handle)
+            dlclose(handle);
+#endif
+    }
+};
+
+const void *hostGetExtension(const clap_host *, const char *) { return nullptr; }
+void hostRequestNothing(const clap_host *) {}
+
+const clap_host renderHost = {CLAP_VERSION,       nullptr,
+                              "clap-saw-demo-render-check",
+                              "Surge Synth Team", "",
+                              "1.0.0",            hostGetExtension,
+                              hostRequestNothing, hostRequestNothing,
+                              hostRequestNothing};
+
+// Set the render mode and oversampling a scene asks for, which have to be in place at activate
+bool prepareScene(const clap_plugin_t *plugin, const Scene &scene)
+{
+    if (scene.offline)
+    {
+        auto render = static_cast<const clap_plugin_render_t *>(
+            plugin->get_extension(plugin, CLAP_EXT_RENDER));
+        if (!render || !render->set(plugin, CLAP_RENDER_OFFLINE))
+            return false;
+    }
+    if (scene.oversampling != 0)
+    {
+        auto params = static_cast<const clap_plugin_params_t *>(
+            plugin->get_extension(plugin, CLAP_EXT_PARAMS));
+        if (!params)
+            return false;
+        HostEventList el;
+        el.paramValue(0, ClapSawDemo::pmOversampling, scene.oversampling);
+        params->flush(plugin, &el.in, &tools::discardOutputEvents);
+    }
+    return true;
+}
+
+// Render a scene with a fresh plugin instance, returning interleaved stereo
+bool renderScene(const clap_plugin_factory_t *factory, const Scene &scene, double sampleRate,
+                 uint32_t blockSize, std::vector<float> &out)
+{
+    auto desc = factory->get_plugin_descriptor(factory, 0);
+    auto plugin = factory->create_plugin(factory, &renderHost, desc->id);
+    if (!plugin || !plugin->init(plugin) || !prepareScene(plugin, scene) ||
+        !plugin->activate(plugin, sampleRate, 1, blockSize) || !plugin->start_processing(plugin))
+    {
+        std::cerr << "Unable to start plugin '" << desc->id << "'" << std::endl;
+        return false;
+    }
+
+    std::vector<float> L(blockSize), R(blockSize);
+    float *outs[2]{L.data(), R.data()};
+    clap_audio_buffer_t buffer{};
+    buffer.data32 = outs;
+    buffer.channel_count = 2;
+
+    HostEventList el;
+    clap_process_t process{};
+    process.audio_outputs = &buffer;
+    process.audio_outputs_count = 1;
+    process.in_events = &el.in;
+    process.out_events = &tools::discardOutputEvents;
+
+    auto total = (uint64_t)std::llround(scene.seconds * sampleRate);
+    out.clear();
+    out.reserve(total * 2);
+    for (uint64_t pos = 0; pos < total; pos += blockSize)
+    {
+        auto frames = (uint32_t)std::min((uint64_t)blockSize, total - pos);
+        el.clear();
+        scene.script(Block{el, pos, frames, sampleRate});
+        el.sortByTime();
+
+        process.frames_count = frames;
+        process.steady_time = (int64_t)pos;
+        plugin->process(plugin, &process);
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            out.push_back(L[i]);
+            out.push_back(R[i]);
+        }
+    }
+
+    plugin->stop_processing(plugin);
+    plugin->deactivate(plugin);
+    plugin->destroy(plugin);
+    return true;
+}
+
+/*
+ * Minimal WAV IO: we only ever read back files we wrote, so the reader handles 32 bit float
+ * stereo and skips any chunks it doesn't need.
+ */
+template <typename T> void writeLE(FILE *f, T v) { fwrite(&v, sizeof(T), 1, f); }
+
+bool writeWav(const std::string &path, const std::vector<float> &data, double sampleRate)
+{
+    auto f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    auto dataBytes = (uint32_t)(data.size() * sizeof(float));
+    fwrite("RIFF", 1, 4, f);
+    writeLE<uint32_t>(f, 36 + dataBytes);
+    fwrite("WAVEfmt ", 1, 8, f);
+    writeLE<uint32_t>(f, 16);
+    writeLE<uint16_t>(f, 3); // WAVE_FORMAT_IEEE_FLOAT
+    writeLE<uint16_t>(f, 2);
+    writeLE<uint32_t>(f, (uint32_t)sampleRate);
+    writeLE<uint32_t>(f, (uint32_t)sampleRate * 2 * sizeof(float));
+    writeLE<uint16_t>(f, 2 * sizeof(float));
+    writeLE<uint16_t>(f, 32);
+    fwrite("data", 1, 4, f);
+    writeLE<uint32_t>(f, dataBytes);
+    fwrite(data.data(), sizeof(float), data.size(), f);
+    fclose(f);
+    return true;
+}
+
+bool readWav(const std::string &path, std::vector<float> &data)
+{
+    auto f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    char id[5]{0, 0, 0, 0, 0};
+    uint32_t size;
+    bool ok{false};
+    uint16_t format{0}, channels{0}, bits{0};
+    if (fread(id, 1, 4, f) == 4 && !strcmp(id, "RIFF") && fread(&size, 4, 1, f) == 1 &&
+        fread(id, 1, 4, f) == 4 && !strcmp(id, "WAVE"))
+    {
+        while (fread(id, 1, 4, f) == 4 && fread(&size, 4, 1, f) == 1)
+        {
+            if (!strcmp(id, "fmt ") && size >= 16)
+            {
+                uint32_t skip32;
+                fread(&format, 2, 1, f);
+                fread(&channels, 2, 1, f);
+                fread(&skip32, 4, 1, f);
+                fread(&skip32, 4, 1, f);
+                fread(&skip32, 2, 1, f);
+                fread(&bits, 2, 1, f);
+                fseek(f, size - 16, SEEK_CUR);
+            }
+            else if (!strcmp(id, "data"))
+            {
+                if (format != 3 || channels != 2 || bits != 32)
+                    break;
+                data.resize(size / sizeof(float));
+                ok = fread(data.data(), sizeof(float), data.size(), f) == data.size();
+                break;
+            }
+            else
+            {
+                fseek(f, size + (size & 1), SEEK_CUR);
+            }
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+int usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s <plugin.clap> (--record <dir> | --compare <dir>) [--tolerance t]\n"
+            "          [--block-size n] [--sample-rate sr] [--scene name] [--out <dir>]\n",
+            argv0);
+    return 2;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // The plugin's debug output goes to std::cout; keep stdout for the report
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    if (argc < 4)
+        return usage(argv[0]);
+
+    std::string pluginPath = argv[1], recordDir, compareDir, outDir, onlyScene;
+    double tolerance{1e-4}, sampleRate{48000};
+    uint32_t blockSize{256};
+
+    for (int i = 2; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        if (i + 1 >= argc)
+            return usage(argv[0]);
+        auto val = argv[++i];
+
+        if (arg == "--record")
+            recordDir = val;
+        else if (arg == "--compare")
+            compareDir = val;
+        else if (arg == "--out")
+            outDir = val;
+        else if (arg == "--scene")
+            onlyScene = val;
+        else if (arg == "--tolerance")
+            tolerance = std::atof(val);
+        else if (arg == "--sample-rate")
+            sampleRate = std::atof(val);
+        else if (arg == "--block-size")
+            blockSize = (uint32_t)std::atoi(val);
+        else
+            return usage(argv[0]);
+    }
+    if (recordDir.empty() == compareDir.empty() || blockSize == 0 || sampleRate <= 0 ||
+        tolerance < 0)
+        return usage(argv[0]);
+
+    for (const auto &dir : {recordDir, outDir})
+    {
+        std::error_code ec;
+        if (!dir.empty() && !std::filesystem::create_directories(dir, ec) && ec)
+        {
+            fprintf(stderr, "Unable to create '%s': %s\n", dir.c_str(), ec.message().c_str());
+            return 2;
+        }
+    }
+
+    LoadedClap clap;
+    if (!clap.load(pluginPath))
+    {
+        fprintf(stderr, "Unable to load a CLAP from '%s'\n", pluginPath.c_str());
+        return 2;
+    }
+    auto factory = static_cast<const clap_plugin_factory_t *>(
+        clap.entry->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    if (!factory || factory->get_plugin_count(factory) < 1)
+    {
+        fprintf(stderr, "'%s' has no plugin factory\n", pluginPath.c_str());
+        return 2;
+    }
+
+    int failures{0}, ran{0};
+    std::vector<float> render, reference;
+    for (const auto &scene : scenes())
+    {
+        if (!onlyScene.empty() && scene.name != onlyScene)
+            continue;
+        ran++;
+
+        if (!renderScene(factory, scene, sampleRate, blockSize, render))
+            return 2;
+        if (!outDir.empty())
+            writeWav(outDir + "/" + scene.name + ".wav", render, sampleRate);
+
+        if (!recordDir.empty())
+        {
+            auto path = recordDir + "/" + scene.name + ".wav";
+            if (!writeWav(path, render, sampleRate))
+            {
+                fprintf(stderr, "Unable to write '%s'\n", path.c_str());
+                return 2;
+            }
+            printf("%-16s recorded %s\n", scene.name.c_str(), path.c_str());
+            continue;
+        }
+
+        auto path = compareDir + "/" + scene.name + ".wav";
+        if (!readWav(path, reference))
+        {
+            printf("%-16s FAIL no reference at %s\n", scene.name.c_str(), path.c_str());
+            failures++;
+            continue;
+        }
+        if (reference.size() != render.size())
+        {
+            printf("%-16s FAIL length %zu frames; reference has %zu\n", scene.name.c_str(),
+                   render.size() / 2, reference.size() / 2);
+            failures++;
+            continue;
+        }
+
+        double maxDiff{0}, sumSq{0};
+        size_t worst{0};
+        for (size_t i = 0; i < render.size(); ++i)
+        {
+            auto d = std::fabs((double)render[i] - reference[i]);
+            if (!(d <= maxDiff)) // so a NaN counts as the worst difference
+            {
+                maxDiff = std::isnan(d) ? INFINITY : d;
+                worst = i;
+            }
+            sumSq += std::isnan(d) ? 0 : d * d;
+        }
+        auto pass = maxDiff <= tolerance;
+        printf("%-16s %s max diff %.3g at frame %zu, rms diff %.3g\n", scene.name.c_str(),
+               pass ? "ok  " : "FAIL", maxDiff, worst / 2, std::sqrt(sumSq / render.size()));
+        if (!pass)
+            failures++;
+    }
+
+    if (ran == 0)
+    {
+        fprintf(stderr, "No scene named '%s'\n", onlyScene.c_str());
+        return 2;
+    }
+    if (!compareDir.empty())
+        printf("%d of %d scenes %s\n", ran - failures, ran,
+               failures ? "match; FAILED" : "match");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * ClapSawDemo
+ * https://github.com/surge-synthesizer/clap-saw-demo
+ *
+ * Copyright 2022 Paul Walker and others as listed in the git history
+ *
+ * Released under the MIT License. See LICENSE.md for full text.
+ */
+
+#ifndef CLAP_SAW_DEMO_HOST_EVENT_LIST_H
+#define CLAP_SAW_DEMO_HOST_EVENT_LIST_H
+
+/*
+ * The tools in this directory act as small CLAP hosts. HostEventList is the event list they
+ * hand to the plugin: a time ordered list of the few event types they send, presented as a
+ * clap_input_events. Events are stored inline so building a block's events doesn't allocate
+ * once the list has grown to its working size.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <clap/clap.h>
+
+namespace sst::clap_saw_demo::tools
+{
+struct HostEventList
+{
+    union Event
+    {
+        clap_event_header_t header;
+        clap_event_note note;
+        clap_event_note_expression expression;
+        clap_event_param_value value;
+        clap_event_param_mod mod;
+        clap_event_midi midi;
+    };
+    std::vector<Event> events;
+    clap_input_events_t in{this, size, get};
+
+    HostEventList() = default;
+    HostEventList(const HostEventList &) = delete;
+    HostEventList &operator=(const HostEventList &) = delete;
+
+    static uint32_t size(const clap_input_events_t *l)
+    {
+        return (uint32_t)static_cast<HostEventList *>(l->ctx)->events.size();
+    }
+    static const clap_event_header_t *get(const clap_input_events_t *l, uint32_t i)
+    {
+        return &static_cast<HostEventList *>(l->ctx)->events[i].header;
+    }
+
+    void clear() { events.clear(); }
+
+    static clap_event_header_t header(uint32_t time, uint16_t type, uint32_t size)
+    {
+        clap_event_header_t h;
+        h.size = size;
+        h.time = time;
+        h.space_id = CLAP_CORE_EVENT_SPACE_ID;
+        h.type = type;
+        h.flags = 0;
+        return h;
+    }
+
+    void note(uint32_t time, uint16_t type, int key, int noteId, double velocity = 1.0)
+    {
+        Event e;
+        e.note.header = header(time, type, sizeof(clap_event_note));
+        e.note.note_id = noteId;
+        e.note.port_index = 0;
+        e.note.channel = 0;
+        e.note.key = key;
+        e.note.velocity = velocity;
+        events.push_back(e);
+    }
+    void noteOn(uint32_t time, int key, int noteId, double velocity = 1.0)
+    {
+        note(time, CLAP_EVENT_NOTE_ON, key, noteId, velocity);
+    }
+    void noteOff(uint32_t time, int key, int noteId)
+    {
+        note(time, CLAP_EVENT_NOTE_OFF, key, noteId, 0.0);
+    }
+
+    void noteExpression(uint32_t time, clap_note_expression expressionId, int key, double value)
+    {
+        Event e;
+        e.expression.header =
+            header(time, CLAP_EVENT_NOTE_EXPRESSION, sizeof(clap_event_note_expression));
+        e.expression.expression_id = expressionId;
+        e.expression.note_id = -1;
+        e.expression.port_index = 0;
+        e.expression.channel = 0;
+        e.expression.key = key;
+        e.expression.value = value;
+        events.push_back(e);
+    }
+
+    void paramValue(uint32_t time, clap_id param, double value)
+    {
+        Event e;
+        e.value.header = header(time, CLAP_EVENT_PARAM_VALUE, sizeof(clap_event_param_value));
+        e.value.param_id = param;
+        e.value.cookie = nullptr;
+        e.value.note_id = -1;
+        e.value.port_index = -1;
+        e.value.channel = -1;
+        e.value.key = -1;
+        e.value.value = value;
+        events.push_back(e);
+    }
+
+    void paramMod(uint32_t time, clap_id param, int noteId, double amount)
+    {
+        Event e;
+        e.mod.header = header(time, CLAP_EVENT_PARAM_MOD, sizeof(clap_event_param_mod));
+        e.mod.param_id = param;
+        e.mod.cookie = nullptr;
+        e.mod.note_id = noteId;
+        e.mod.port_index = -1;
+        e.mod.channel = -1;
+        e.mod.key = -1;
+        e.mod.amount = amount;
+        events.push_back(e);
+    }
+
+    void midi(uint32_t time, uint8_t b0, uint8_t b1, uint8_t b2)
+    {
+        Event e;
+        e.midi.header = header(time, CLAP_EVENT_MIDI, sizeof(clap_event_midi));
+        e.midi.port_index = 0;
+        e.midi.data[0] = b0;
+        e.midi.data[1] = b1;
+        e.midi.data[2] = b2;
+        events.push_back(e);
+    }
+
+    void sortByTime()
+    {
+        std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b)
+                         { return a.header.time < b.header.time; });
+    }
+};
+
+// An output event list which accepts and discards everything
+inline bool discardTryPush(const clap_output_events_t *, const clap_event_header_t *)
+{
+    return true;
+}
+static const clap_output_events_t discardOutputEvents{nullptr, discardTryPush};
+} // namespace sst::clap_saw_demo::tools
+
+#endif // CLAP_SAW_DEMO_HOST_EVENT_LIST_H